@@ -0,0 +1,122 @@
+#include "Archive.hpp"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Archive::~Archive() {
+  Close();
+}
+
+bool Archive::Open(const std::string& path) {
+  Close();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(ArchiveHeader)) {
+    std::cerr << "Failed to open archive " << path << std::endl;
+    close(fd);
+    return false;
+  }
+
+  // The mapping stays valid after the descriptor is closed
+  void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    std::cerr << "Failed to map archive " << path << std::endl;
+    return false;
+  }
+
+  _mapping = static_cast<const char*>(mapping);
+  _mapping_size = static_cast<size_t>(info.st_size);
+
+  ArchiveHeader header;
+  std::memcpy(&header, _mapping, sizeof(header));
+  size_t tableEnd = sizeof(header) + static_cast<size_t>(header.entry_count) * sizeof(ArchiveEntry);
+
+  if (std::memcmp(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0 || header.version != ARCHIVE_VERSION
+    || tableEnd + header.names_size > _mapping_size) {
+    std::cerr << "Failed to open archive " << path << ", not a version " << ARCHIVE_VERSION << " archive" << std::endl;
+    Close();
+    return false;
+  }
+
+  _entries = reinterpret_cast<const ArchiveEntry*>(_mapping + sizeof(header));
+  _entry_count = header.entry_count;
+  _names = _mapping + tableEnd;
+
+  // Checked once here so lookups can trust the table
+  for (uint32_t i = 0; i < _entry_count; i++) {
+    const ArchiveEntry& entry = _entries[i];
+    if (entry.name_offset + static_cast<uint64_t>(entry.name_length) > header.names_size
+      || entry.offset + entry.stored_size > _mapping_size) {
+      std::cerr << "Failed to open archive " << path << ", entry " << i << " is out of bounds" << std::endl;
+      Close();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void Archive::Close() {
+  if (_mapping != nullptr)
+    munmap(const_cast<char*>(_mapping), _mapping_size);
+
+  _mapping = nullptr;
+  _mapping_size = 0;
+  _entries = nullptr;
+  _entry_count = 0;
+  _names = nullptr;
+}
+
+bool Archive::IsOpen() const {
+  return _mapping != nullptr;
+}
+
+const ArchiveEntry* Archive::Find(const std::string& name) const {
+  auto nameOf = [this](const ArchiveEntry& entry) {
+    return std::string_view(_names + entry.name_offset, entry.name_length);
+  };
+
+  const ArchiveEntry* last = _entries + _entry_count;
+  const ArchiveEntry* entry = std::lower_bound(_entries, last, name, [&](const ArchiveEntry& e, const std::string& n) {
+    return nameOf(e) < n;
+  });
+
+  if (entry == last || nameOf(*entry) != name) return nullptr;
+  return entry;
+}
+
+bool Archive::Contains(const std::string& name) const {
+  return Find(name) != nullptr;
+}
+
+Resource Archive::Read(const std::string& name, std::vector<char>& scratch) const {
+  const ArchiveEntry* entry = Find(name);
+  if (entry == nullptr) return {};
+
+  const char* stored = _mapping + entry->offset;
+  if (entry->compression == ArchiveCompression::None)
+    return Resource(stored, static_cast<size_t>(entry->stored_size));
+
+  if (entry->compression == ArchiveCompression::Zlib) {
+    scratch.resize(static_cast<size_t>(entry->size));
+    int inflated = stbi_zlib_decode_buffer(scratch.data(), static_cast<int>(scratch.size()), stored, static_cast<int>(entry->stored_size));
+    if (inflated == static_cast<int>(entry->size))
+      return Resource(scratch.data(), scratch.size());
+  }
+
+  std::cerr << "Failed to decompress archive entry " << name << std::endl;
+  return {};
+}
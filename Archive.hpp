@@ -0,0 +1,67 @@
+#ifndef ARCHIVE_HPP
+#define ARCHIVE_HPP
+
+#include "Resource.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On disk an archive is an ArchiveHeader, entry_count ArchiveEntries sorted by name, the names, then
+// every payload starting on an ARCHIVE_ALIGNMENT boundary. All fields are little endian. Written by
+// the ResourcePacker tool.
+static const char ARCHIVE_MAGIC[4] = {'G', 'P', 'A', 'K'};
+static const uint32_t ARCHIVE_VERSION = 1;
+// Enough for uint32_t SPIR-V words and 16 byte vector loads straight out of the mapping
+static const uint32_t ARCHIVE_ALIGNMENT = 16;
+
+enum class ArchiveCompression : uint32_t {
+  None = 0,
+  Zlib = 1
+};
+
+struct ArchiveHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t entry_count;
+  uint32_t names_size; // bytes of names following the entry table
+};
+
+struct ArchiveEntry {
+  uint32_t name_offset; // into the names, which aren't null terminated
+  uint32_t name_length;
+  uint64_t offset; // from the start of the file
+  uint64_t stored_size;
+  uint64_t size; // after decompression
+  ArchiveCompression compression;
+  uint32_t reserved;
+};
+
+// A packed archive mapped into memory once. Uncompressed entries are handed out as views straight into
+// the mapping, so reading them costs neither a file open nor a copy. Lookups are safe from any thread.
+class Archive {
+public:
+  Archive() = default;
+  ~Archive();
+  Archive(const Archive&) = delete;
+  Archive& operator=(const Archive&) = delete;
+
+  bool Open(const std::string& path);
+  bool IsOpen() const;
+  bool Contains(const std::string& name) const;
+  // View of an entry. Compressed entries are inflated into scratch and the view points there instead.
+  // Returns an empty view if there is no such entry or it can't be decompressed.
+  Resource Read(const std::string& name, std::vector<char>& scratch) const;
+
+protected:
+  const ArchiveEntry* Find(const std::string& name) const;
+  void Close();
+
+  const char* _mapping = nullptr;
+  size_t _mapping_size = 0;
+  const ArchiveEntry* _entries = nullptr;
+  uint32_t _entry_count = 0;
+  const char* _names = nullptr;
+};
+
+#endif
@@ -0,0 +1,249 @@
+#include "AssetLoader.hpp"
+
+#include "Profiler.hpp"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// KTX 1 header, https://registry.khronos.org/KTX/specs/1.0/ktxspec.v1.html
+struct KtxHeader {
+  uint8_t identifier[12];
+  uint32_t endianness;
+  uint32_t gl_type;
+  uint32_t gl_type_size;
+  uint32_t gl_format;
+  uint32_t gl_internal_format;
+  uint32_t gl_base_internal_format;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t array_elements;
+  uint32_t faces;
+  uint32_t mip_levels;
+  uint32_t key_value_bytes;
+};
+
+static const uint8_t KTX_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+static const uint32_t KTX_ENDIANNESS = 0x04030201;
+static const uint32_t GL_UNSIGNED_BYTE_TYPE = 0x1401;
+static const uint32_t GL_RGBA8_FORMAT = 0x8058;
+
+bool Image::Valid() const {
+  return pixels != nullptr;
+}
+
+size_t Image::Bytes() const {
+  return static_cast<size_t>(width) * height * 4;
+}
+
+static std::vector<char> ReadLooseFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) return {};
+
+  std::vector<char> data(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(data.data(), data.size());
+  return data;
+}
+
+// Only the first mip level of little endian, uncompressed RGBA8 files is read
+static Image DecodeKtx(Resource file, const std::string& path) {
+  KtxHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+
+  if (header.endianness != KTX_ENDIANNESS || header.gl_type != GL_UNSIGNED_BYTE_TYPE
+    || header.gl_internal_format != GL_RGBA8_FORMAT || header.pixel_depth > 1 || header.faces > 1) {
+    std::cerr << "Failed to decode " << path << ", only 2D RGBA8 KTX files are supported" << std::endl;
+    return {};
+  }
+
+  Image image;
+  image.width = header.pixel_width;
+  image.height = header.pixel_height;
+
+  size_t offset = sizeof(header) + header.key_value_bytes;
+  uint32_t imageSize = 0;
+  if (offset + sizeof(imageSize) <= file.size())
+    std::memcpy(&imageSize, file.data() + offset, sizeof(imageSize));
+  offset += sizeof(imageSize);
+
+  if (imageSize < image.Bytes() || offset + image.Bytes() > file.size()) {
+    std::cerr << "Failed to decode " << path << ", truncated KTX file" << std::endl;
+    return {};
+  }
+
+  unsigned char* pixels = new unsigned char[image.Bytes()];
+  std::memcpy(pixels, file.data() + offset, image.Bytes());
+  image.pixels = std::shared_ptr<const unsigned char>(pixels, std::default_delete<unsigned char[]>());
+  return image;
+}
+
+static Image DecodeImage(Resource file, const std::string& path) {
+  if (file.empty()) {
+    std::cerr << "Failed to read " << path << std::endl;
+    return {};
+  }
+
+  if (file.size() >= sizeof(KtxHeader) && std::memcmp(file.data(), KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) == 0)
+    return DecodeKtx(file, path);
+
+  int width = 0, height = 0, channels = 0;
+  stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.data()), static_cast<int>(file.size()),
+    &width, &height, &channels, STBI_rgb_alpha);
+
+  if (!pixels) {
+    std::cerr << "Failed to decode " << path << ": " << stbi_failure_reason() << std::endl;
+    return {};
+  }
+
+  Image image;
+  image.pixels = std::shared_ptr<const unsigned char>(pixels, [](const unsigned char* p) { stbi_image_free(const_cast<unsigned char*>(p)); });
+  image.width = static_cast<uint32_t>(width);
+  image.height = static_cast<uint32_t>(height);
+  return image;
+}
+
+static std::vector<std::string> ParseManifest(Resource file, const std::string& path) {
+  if (file.empty())
+    std::cerr << "Failed to read manifest " << path << std::endl;
+
+  std::string directory;
+  size_t slash = path.find_last_of('/');
+  if (slash != std::string::npos)
+    directory = path.substr(0, slash + 1);
+
+  std::vector<std::string> entries;
+  std::istringstream lines(std::string(file.begin(), file.end()));
+  std::string line;
+  while (std::getline(lines, line)) {
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#') continue;
+    size_t last = line.find_last_not_of(" \t\r");
+    std::string entry = line.substr(first, last - first + 1);
+
+    entries.push_back(entry[0] == '/' ? entry : directory + entry);
+  }
+
+  return entries;
+}
+
+static std::vector<char> CopyFile(Resource file, const std::string&) {
+  return std::vector<char>(file.begin(), file.end());
+}
+
+AssetLoader::AssetLoader(unsigned thread_count) {
+  for (unsigned i = 0; i < std::max(1u, thread_count); i++)
+    _threads.emplace_back(&AssetLoader::WorkerLoop, this);
+}
+
+AssetLoader::~AssetLoader() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _wake.notify_all();
+
+  for (std::thread& thread : _threads)
+    thread.join();
+}
+
+bool AssetLoader::Mount(const std::string& path) {
+  return _archive.Open(path);
+}
+
+template <typename T>
+T AssetLoader::WithFile(const std::string& path, T (*use)(Resource, const std::string&)) const {
+  if (_archive.IsOpen() && _archive.Contains(path)) {
+    std::vector<char> scratch;
+    return use(_archive.Read(path, scratch), path);
+  }
+
+  std::vector<char> file = ReadLooseFile(path);
+  return use(Resource(file.data(), file.size()), path);
+}
+
+template <typename T>
+std::shared_future<T> AssetLoader::Enqueue(std::function<T()> load, std::function<void(const T&)> done) {
+  auto task = std::make_shared<std::packaged_task<T()>>(std::move(load));
+  std::shared_future<T> result = task->get_future().share();
+
+  auto job = [this, task, result, done]() {
+    (*task)();
+    if (!done) return;
+
+    std::lock_guard<std::mutex> lock(_completions_mutex);
+    _completions.push_back([result, done]() { done(result.get()); });
+  };
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _jobs.push_back(std::move(job));
+  }
+  _wake.notify_one();
+
+  return result;
+}
+
+std::shared_future<std::vector<char>> AssetLoader::ReadFile(const std::string& path,
+  std::function<void(const std::vector<char>&)> done) {
+  return Enqueue<std::vector<char>>([this, path]() {
+    PROFILE_SCOPE("ReadFile");
+    return WithFile(path, CopyFile);
+  }, std::move(done));
+}
+
+std::shared_future<Image> AssetLoader::LoadImage(const std::string& path, std::function<void(const Image&)> done) {
+  return Enqueue<Image>([this, path]() {
+    PROFILE_SCOPE("LoadImage");
+    return WithFile(path, DecodeImage);
+  }, std::move(done));
+}
+
+std::shared_future<std::vector<std::string>> AssetLoader::LoadManifest(const std::string& path,
+  std::function<void(const std::vector<std::string>&)> done) {
+  return Enqueue<std::vector<std::string>>([this, path]() {
+    PROFILE_SCOPE("LoadManifest");
+    return WithFile(path, ParseManifest);
+  }, std::move(done));
+}
+
+size_t AssetLoader::RunCompletions(size_t max_completions) {
+  size_t ran = 0;
+
+  while (ran < max_completions) {
+    std::function<void()> completion;
+    {
+      std::lock_guard<std::mutex> lock(_completions_mutex);
+      if (_completions.empty()) break;
+      completion = std::move(_completions.front());
+      _completions.pop_front();
+    }
+
+    // Run outside the lock, callbacks are free to start more loads
+    completion();
+    ran++;
+  }
+
+  return ran;
+}
+
+void AssetLoader::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(_mutex);
+
+  while (true) {
+    _wake.wait(lock, [this] { return _stopping || !_jobs.empty(); });
+    if (_stopping) return;
+
+    std::function<void()> job = std::move(_jobs.front());
+    _jobs.pop_front();
+
+    lock.unlock();
+    job();
+    lock.lock();
+  }
+}
@@ -0,0 +1,74 @@
+#ifndef ASSET_LOADER_HPP
+#define ASSET_LOADER_HPP
+
+#include "Archive.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Decoded RGBA8 pixels, empty if the file couldn't be read or decoded
+struct Image {
+  std::shared_ptr<const unsigned char> pixels;
+  uint32_t width = 0;
+  uint32_t height = 0;
+
+  bool Valid() const;
+  size_t Bytes() const;
+};
+
+// Reads and decodes assets on its own threads. Every load returns a future, and can also take a callback
+// that runs with the result on whichever thread calls RunCompletions, so GPU uploads and other
+// single-threaded work stay on that thread while the next file is already being read.
+//
+// Paths found in the mounted archive are read out of its mapping, anything else from loose files. Loads
+// can be started from any thread. Callbacks that haven't run by the time the loader is destroyed are
+// dropped.
+class AssetLoader {
+public:
+  explicit AssetLoader(unsigned thread_count);
+  ~AssetLoader();
+  AssetLoader(const AssetLoader&) = delete;
+  AssetLoader& operator=(const AssetLoader&) = delete;
+
+  // Before any loads are started, returns false if there is no archive at path
+  bool Mount(const std::string& path);
+
+  std::shared_future<std::vector<char>> ReadFile(const std::string& path,
+    std::function<void(const std::vector<char>&)> done = nullptr);
+  // PNG and anything else stb_image reads, or KTX 1 files holding uncompressed RGBA8
+  std::shared_future<Image> LoadImage(const std::string& path, std::function<void(const Image&)> done = nullptr);
+  // One path per line relative to the manifest, blank lines and lines starting with # are skipped
+  std::shared_future<std::vector<std::string>> LoadManifest(const std::string& path,
+    std::function<void(const std::vector<std::string>&)> done = nullptr);
+
+  // Runs up to max_completions finished callbacks on the calling thread, returns how many ran
+  size_t RunCompletions(size_t max_completions = SIZE_MAX);
+
+protected:
+  template <typename T>
+  std::shared_future<T> Enqueue(std::function<T()> load, std::function<void(const T&)> done);
+  void WorkerLoop();
+  // Calls use with the file's bytes, straight from the archive when it has them
+  template <typename T>
+  T WithFile(const std::string& path, T (*use)(Resource, const std::string&)) const;
+
+  std::vector<std::thread> _threads;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::deque<std::function<void()>> _jobs;
+  bool _stopping = false;
+  Archive _archive;
+
+  std::mutex _completions_mutex;
+  std::deque<std::function<void()>> _completions;
+};
+
+#endif
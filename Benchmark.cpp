@@ -0,0 +1,258 @@
+#include "EntityStore.hpp"
+#include "Renderer.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Renders a scripted scene without a window so frame times can be compared between builds and machines.
+// On boxes without a GPU point the loader at a software ICD, e.g.
+//   VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json ./GBench --frames 300
+
+struct BenchmarkOptions {
+  unsigned width = 1280;
+  unsigned height = 720;
+  unsigned frames = 1000;
+  unsigned sprites = 100000;
+  unsigned tiles = 0; // side of a square tilemap under the sprites, 0 for none
+  unsigned gpu_sprites = 0; // static sprites culled and drawn on the GPU
+  const char* png = nullptr;
+  const char* trace = nullptr;
+  LatencyMode latency = LatencyMode::VSync;
+  VertexFormat vertex_format = VertexFormat::Full;
+  unsigned layers = 1; // sprites are spread over this many layers
+  unsigned opaque = 0; // percentage of sprites marked opaque
+  bool depth_layering = false;
+  unsigned spread = 1; // entities are spread over this many times the output in each direction
+  bool cull = false; // only entities the spatial hash finds under the camera are drawn
+};
+
+static void PrintUsage(const char* name) {
+  std::cout << "Usage: " << name << " [--width N] [--height N] [--frames N] [--sprites N] [--tiles N] [--gpu-sprites N]"
+    << " [--png path]"
+    << " [--trace path] [--latency low|vsync|throughput] [--vertices full|packed] [--layers N] [--opaque percent]"
+    << " [--depth on|off] [--spread N] [--cull on|off]" << std::endl;
+}
+
+static bool ParseOptions(int argc, char *argv[], BenchmarkOptions& options) {
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 >= argc) {
+      PrintUsage(argv[0]);
+      return false;
+    }
+
+    if (strcmp(argv[i], "--width") == 0) options.width = std::stoul(argv[++i]);
+    else if (strcmp(argv[i], "--height") == 0) options.height = std::stoul(argv[++i]);
+    else if (strcmp(argv[i], "--frames") == 0) options.frames = std::stoul(argv[++i]);
+    else if (strcmp(argv[i], "--sprites") == 0) options.sprites = std::stoul(argv[++i]);
+    else if (strcmp(argv[i], "--tiles") == 0) options.tiles = std::stoul(argv[++i]);
+    else if (strcmp(argv[i], "--gpu-sprites") == 0) options.gpu_sprites = std::stoul(argv[++i]);
+    else if (strcmp(argv[i], "--layers") == 0) options.layers = std::max(1ul, std::stoul(argv[++i]));
+    else if (strcmp(argv[i], "--opaque") == 0) options.opaque = std::stoul(argv[++i]);
+    else if (strcmp(argv[i], "--spread") == 0) options.spread = std::max(1ul, std::stoul(argv[++i]));
+    else if (strcmp(argv[i], "--png") == 0) options.png = argv[++i];
+    else if (strcmp(argv[i], "--trace") == 0) options.trace = argv[++i];
+    else if (strcmp(argv[i], "--latency") == 0) {
+      // Headless has no present mode, only the number of frames in flight changes
+      const char* mode = argv[++i];
+      if (strcmp(mode, "low") == 0) options.latency = LatencyMode::LowLatency;
+      else if (strcmp(mode, "vsync") == 0) options.latency = LatencyMode::VSync;
+      else if (strcmp(mode, "throughput") == 0) options.latency = LatencyMode::Throughput;
+      else {
+        PrintUsage(argv[0]);
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "--vertices") == 0) {
+      const char* format = argv[++i];
+      if (strcmp(format, "full") == 0) options.vertex_format = VertexFormat::Full;
+      else if (strcmp(format, "packed") == 0) options.vertex_format = VertexFormat::Packed;
+      else {
+        PrintUsage(argv[0]);
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "--depth") == 0) {
+      const char* depth = argv[++i];
+      if (strcmp(depth, "on") == 0) options.depth_layering = true;
+      else if (strcmp(depth, "off") == 0) options.depth_layering = false;
+      else {
+        PrintUsage(argv[0]);
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "--cull") == 0) {
+      const char* cull = argv[++i];
+      if (strcmp(cull, "on") == 0) options.cull = true;
+      else if (strcmp(cull, "off") == 0) options.cull = false;
+      else {
+        PrintUsage(argv[0]);
+        return false;
+      }
+    }
+    else {
+      PrintUsage(argv[0]);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Sprite ids of the scene's entities, translucent and opaque
+static std::vector<SpriteFrame> BuildSpriteFrames() {
+  SpriteFrame translucent = {{16.0f, 16.0f}, {0.0f, 0.0f, 0.0625f, 0.0625f}};
+  SpriteFrame opaque = translucent;
+  opaque.opaque = true;
+
+  return {translucent, opaque};
+}
+
+// One entity per sprite on its own anchor, moving off in its own direction
+static void BuildScene(EntityStore& entities, const BenchmarkOptions& options) {
+  entities.Reserve(options.sprites);
+
+  for (size_t i = 0; i < options.sprites; ++i) {
+    glm::vec2 anchor = {static_cast<float>((i * 7919) % (options.width * options.spread)), 
+      static_cast<float>((i * 104729) % (options.height * options.spread))};
+    float direction = static_cast<float>(i % 360) * 0.0174533f;
+    uint32_t sprite = (i * 37) % 100 < options.opaque ? 1 : 0;
+
+    EntityHandle entity = entities.Create(anchor, sprite, {1.0f, 1.0f, 1.0f}, static_cast<uint32_t>(i % options.layers));
+    entities.SetVelocity(entity, {std::cos(direction), std::sin(direction)});
+  }
+}
+
+// The step is shared by every entity and swings back and forth, so each one oscillates 32 pixels along
+// its velocity around its anchor and the scene still only depends on the frame number
+static void UpdateScene(EntityStore& entities, unsigned frame) {
+  float dt = 32.0f * (std::sin((frame + 1) * 0.02f) - std::sin(frame * 0.02f));
+  entities.Integrate(dt);
+}
+
+// A checkerboard of four atlas cells, only the chunks under the camera get drawn
+static std::shared_ptr<Tilemap> BuildTilemap(unsigned size) {
+  std::vector<glm::vec4> tileUvs = {
+    {0.0f, 0.0f, 0.0625f, 0.0625f}, {0.0625f, 0.0f, 0.0625f, 0.0625f},
+    {0.0f, 0.0625f, 0.0625f, 0.0625f}, {0.0625f, 0.0625f, 0.0625f, 0.0625f}
+  };
+
+  auto tilemap = std::make_shared<Tilemap>(size, size, 16.0f, tileUvs);
+  for (unsigned y = 0; y < size; ++y) {
+    for (unsigned x = 0; x < size; ++x) {
+      tilemap->SetTile(x, y, static_cast<uint16_t>(1 + (x + y) % 4));
+    }
+  }
+
+  return tilemap;
+}
+
+// Scattered over twice the output in each direction, so about a quarter of them survive the cull pass
+static std::shared_ptr<const std::vector<GpuSprite>> BuildGpuSprites(unsigned count, unsigned width, unsigned height) {
+  auto sprites = std::make_shared<std::vector<GpuSprite>>(count);
+  for (size_t i = 0; i < sprites->size(); ++i) {
+    GpuSprite& s = (*sprites)[i];
+    s.pos = {static_cast<float>((i * 7919) % (width * 2)) - width * 0.5f, 
+      static_cast<float>((i * 104729) % (height * 2)) - height * 0.5f};
+    s.size = {8.0f, 8.0f};
+    s.uv = {0.0625f, 0.0f, 0.0625f, 0.0625f};
+    s.color = 0xFFFFFFFF;
+    s.texture = 0;
+  }
+
+  return sprites;
+}
+
+int main(int argc, char *argv[]) {
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options))
+    return EXIT_FAILURE;
+
+  Profiler::SetEnabled(options.trace != nullptr);
+
+  Renderer renderer;
+  std::vector<const char*> extensions;
+  if (renderer.DebugEnabled()) extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+
+  renderer.SetLatencyMode(options.latency);
+  renderer.SetVertexFormat(options.vertex_format);
+  renderer.SetDepthLayering(options.depth_layering);
+  if (!renderer.InitHeadless(options.width, options.height, "GBench", "GBench", extensions)) {
+    std::cerr << "Failed to initialize renderer" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Rendering " << options.frames << " frames of " << options.sprites << " sprites at " 
+    << options.width << "x" << options.height << " (" << Renderer::LatencyModeName(options.latency) << ")" << std::endl;
+
+  // Sprite vertices are streamed every frame, so this is what the vertex format saves in upload bandwidth
+  size_t vertexSize = (options.vertex_format == VertexFormat::Packed) ? sizeof(PackedVertex) : sizeof(Vertex);
+  std::cout << "Sprite vertices: " << vertexSize << " bytes, " << (vertexSize * 4 * options.sprites) / 1024 
+    << " KiB per frame" << std::endl;
+
+  // The scene goes through the same entity store and output stage as the game's
+  EntityStore entities;
+  std::vector<SpriteFrame> spriteFrames = BuildSpriteFrames();
+  BuildScene(entities, options);
+  SpatialHash spatialHash;
+  std::vector<uint32_t> visibleEntities;
+  size_t submitted = 0;
+
+  FrameSnapshot snapshot;
+  snapshot.camera.size = {static_cast<float>(options.width), static_cast<float>(options.height)};
+  snapshot.previous_camera = snapshot.camera;
+  if (options.tiles > 0)
+    snapshot.tilemap = BuildTilemap(options.tiles);
+  if (options.gpu_sprites > 0)
+    snapshot.gpu_sprites = BuildGpuSprites(options.gpu_sprites, options.width, options.height);
+  FrameStats& stats = renderer.GetFrameStats();
+
+  for (unsigned frame = 0; frame < options.frames; ++frame) {
+    {
+      PROFILE_SCOPE("UpdateScene");
+      UpdateScene(entities, frame);
+      snapshot.tick = frame;
+
+      if (options.cull) {
+        // Same as Game::PublishSnapshot, only what the hash finds under the camera is written out
+        entities.UpdateSpatialHash(spatialHash, spriteFrames);
+        visibleEntities.clear();
+        {
+          PROFILE_SCOPE("CullSprites");
+          spatialHash.Query(snapshot.camera.position, snapshot.camera.position + snapshot.camera.size, visibleEntities);
+        }
+        std::sort(visibleEntities.begin(), visibleEntities.end());
+        entities.WriteSprites(snapshot.sprites, spriteFrames, visibleEntities);
+      } else {
+        entities.WriteSprites(snapshot.sprites, spriteFrames);
+      }
+      snapshot.culled_sprites = entities.Size() - snapshot.sprites.size();
+      submitted += snapshot.sprites.size();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    renderer.DrawFrame(snapshot);
+    auto end = std::chrono::steady_clock::now();
+
+    stats.Record(FrameMetric::CpuFrame, std::chrono::duration<double, std::milli>(end - start).count());
+  }
+
+  if (options.png != nullptr && !renderer.SaveFrame(options.png))
+    return EXIT_FAILURE;
+
+  if (options.trace != nullptr && !Profiler::WriteChromeTrace(options.trace))
+    return EXIT_FAILURE;
+
+  if (options.frames > 0) {
+    std::cout << "Sprites per frame: submitted " << submitted / options.frames << ", culled " 
+      << options.sprites - submitted / options.frames << std::endl;
+  }
+  stats.PrintSummary(std::cout);
+  stats.PrintHistogram(std::cout);
+
+  return EXIT_SUCCESS;
+}
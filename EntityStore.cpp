@@ -0,0 +1,212 @@
+#include "EntityStore.hpp"
+
+#include <algorithm>
+
+// The component arrays never alias, saying so lets the compiler vectorize without runtime overlap checks
+static void IntegrateAxis(float* __restrict pos, float* __restrict prev, const float* __restrict vel, size_t count, float dt) {
+  for (size_t i = 0; i < count; ++i) {
+    prev[i] = pos[i];
+    pos[i] += vel[i] * dt;
+  }
+}
+
+EntityHandle EntityStore::Create(glm::vec2 position, uint32_t sprite_id, glm::vec3 color, uint32_t layer) {
+  uint32_t slot;
+  if (!_free_slots.empty()) {
+    slot = _free_slots.back();
+    _free_slots.pop_back();
+  } else {
+    slot = static_cast<uint32_t>(_slots.size());
+    _slots.emplace_back();
+  }
+
+  _slots[slot].dense = static_cast<uint32_t>(_pos_x.size());
+
+  _pos_x.push_back(position.x);
+  _pos_y.push_back(position.y);
+  _prev_x.push_back(position.x);
+  _prev_y.push_back(position.y);
+  _vel_x.push_back(0.0f);
+  _vel_y.push_back(0.0f);
+  _sprite.push_back(sprite_id);
+  _color.push_back(color);
+  _layer.push_back(layer);
+  _dense_to_slot.push_back(slot);
+
+  return {slot, _slots[slot].generation};
+}
+
+bool EntityStore::Destroy(EntityHandle handle) {
+  uint32_t dense = DenseIndex(handle);
+  if (dense == UINT32_MAX) return false;
+
+  // Fill the hole with the last entity so the arrays stay packed
+  uint32_t last = static_cast<uint32_t>(_pos_x.size() - 1);
+  if (dense != last) {
+    _pos_x[dense] = _pos_x[last];
+    _pos_y[dense] = _pos_y[last];
+    _prev_x[dense] = _prev_x[last];
+    _prev_y[dense] = _prev_y[last];
+    _vel_x[dense] = _vel_x[last];
+    _vel_y[dense] = _vel_y[last];
+    _sprite[dense] = _sprite[last];
+    _color[dense] = _color[last];
+    _layer[dense] = _layer[last];
+    _dense_to_slot[dense] = _dense_to_slot[last];
+    _slots[_dense_to_slot[dense]].dense = dense;
+  }
+
+  _pos_x.pop_back();
+  _pos_y.pop_back();
+  _prev_x.pop_back();
+  _prev_y.pop_back();
+  _vel_x.pop_back();
+  _vel_y.pop_back();
+  _sprite.pop_back();
+  _color.pop_back();
+  _layer.pop_back();
+  _dense_to_slot.pop_back();
+
+  Slot& slot = _slots[handle.slot];
+  slot.dense = UINT32_MAX;
+  slot.generation++;
+  _free_slots.push_back(handle.slot);
+
+  return true;
+}
+
+bool EntityStore::Alive(EntityHandle handle) const {
+  return DenseIndex(handle) != UINT32_MAX;
+}
+
+size_t EntityStore::Size() const {
+  return _pos_x.size();
+}
+
+void EntityStore::Clear() {
+  // Every live handle has to go stale, so the slots are kept and bumped rather than dropped
+  for (uint32_t slot : _dense_to_slot) {
+    _slots[slot].dense = UINT32_MAX;
+    _slots[slot].generation++;
+    _free_slots.push_back(slot);
+  }
+
+  _pos_x.clear();
+  _pos_y.clear();
+  _prev_x.clear();
+  _prev_y.clear();
+  _vel_x.clear();
+  _vel_y.clear();
+  _sprite.clear();
+  _color.clear();
+  _layer.clear();
+  _dense_to_slot.clear();
+}
+
+void EntityStore::Reserve(size_t count) {
+  _pos_x.reserve(count);
+  _pos_y.reserve(count);
+  _prev_x.reserve(count);
+  _prev_y.reserve(count);
+  _vel_x.reserve(count);
+  _vel_y.reserve(count);
+  _sprite.reserve(count);
+  _color.reserve(count);
+  _layer.reserve(count);
+  _dense_to_slot.reserve(count);
+  _slots.reserve(count);
+}
+
+uint32_t EntityStore::DenseIndex(EntityHandle handle) const {
+  if (handle.slot >= _slots.size()) return UINT32_MAX;
+  const Slot& slot = _slots[handle.slot];
+  if (slot.generation != handle.generation) return UINT32_MAX;
+  return slot.dense;
+}
+
+glm::vec2 EntityStore::GetPosition(EntityHandle handle) const {
+  uint32_t i = DenseIndex(handle);
+  if (i == UINT32_MAX) return {0.0f, 0.0f};
+  return {_pos_x[i], _pos_y[i]};
+}
+
+void EntityStore::SetPosition(EntityHandle handle, glm::vec2 position) {
+  uint32_t i = DenseIndex(handle);
+  if (i == UINT32_MAX) return;
+  // A teleport, nothing to interpolate from
+  _pos_x[i] = _prev_x[i] = position.x;
+  _pos_y[i] = _prev_y[i] = position.y;
+}
+
+void EntityStore::SetVelocity(EntityHandle handle, glm::vec2 velocity) {
+  uint32_t i = DenseIndex(handle);
+  if (i == UINT32_MAX) return;
+  _vel_x[i] = velocity.x;
+  _vel_y[i] = velocity.y;
+}
+
+void EntityStore::SetSprite(EntityHandle handle, uint32_t sprite_id) {
+  uint32_t i = DenseIndex(handle);
+  if (i != UINT32_MAX) _sprite[i] = sprite_id;
+}
+
+void EntityStore::SetColor(EntityHandle handle, glm::vec3 color) {
+  uint32_t i = DenseIndex(handle);
+  if (i != UINT32_MAX) _color[i] = color;
+}
+
+void EntityStore::SetLayer(EntityHandle handle, uint32_t layer) {
+  uint32_t i = DenseIndex(handle);
+  if (i != UINT32_MAX) _layer[i] = layer;
+}
+
+void EntityStore::Integrate(float dt) {
+  IntegrateAxis(_pos_x.data(), _prev_x.data(), _vel_x.data(), _pos_x.size(), dt);
+  IntegrateAxis(_pos_y.data(), _prev_y.data(), _vel_y.data(), _pos_y.size(), dt);
+}
+
+void EntityStore::WriteSprite(Sprite& s, uint32_t dense, const std::vector<SpriteFrame>& frames) const {
+  static const SpriteFrame missing = {{0.0f, 0.0f}, {0.0f, 0.0f, 0.0f, 0.0f}};
+  const SpriteFrame& frame = (_sprite[dense] < frames.size()) ? frames[_sprite[dense]] : missing;
+
+  s.pos = {_pos_x[dense], _pos_y[dense]};
+  s.prev_pos = {_prev_x[dense], _prev_y[dense]};
+  s.size = frame.size;
+  s.uv = frame.uv;
+  s.color = _color[dense];
+  s.layer = _layer[dense];
+  s.texture = frame.texture;
+  s.opaque = frame.opaque;
+}
+
+void EntityStore::UpdateSpatialHash(SpatialHash& hash, const std::vector<SpriteFrame>& frames) const {
+  for (size_t i = 0; i < _pos_x.size(); ++i) {
+    glm::vec2 size = (_sprite[i] < frames.size()) ? frames[_sprite[i]].size : glm::vec2(0.0f, 0.0f);
+    glm::vec2 min = {std::min(_pos_x[i], _prev_x[i]), std::min(_pos_y[i], _prev_y[i])};
+    glm::vec2 max = {std::max(_pos_x[i], _prev_x[i]) + size.x, std::max(_pos_y[i], _prev_y[i]) + size.y};
+    hash.Update(_dense_to_slot[i], min, max);
+  }
+}
+
+void EntityStore::WriteSprites(std::vector<Sprite>& out, const std::vector<SpriteFrame>& frames) const {
+  size_t count = _pos_x.size();
+  out.resize(count);
+
+  Sprite* sprites = out.data();
+  for (size_t i = 0; i < count; ++i) {
+    WriteSprite(sprites[i], static_cast<uint32_t>(i), frames);
+  }
+}
+
+void EntityStore::WriteSprites(std::vector<Sprite>& out, const std::vector<SpriteFrame>& frames, const std::vector<uint32_t>& slots) const {
+  out.resize(slots.size());
+
+  Sprite* sprites = out.data();
+  size_t written = 0;
+  for (uint32_t slot : slots) {
+    if (slot >= _slots.size() || _slots[slot].dense == UINT32_MAX) continue;
+    WriteSprite(sprites[written++], _slots[slot].dense, frames);
+  }
+
+  out.resize(written);
+}
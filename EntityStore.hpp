@@ -0,0 +1,74 @@
+#ifndef ENTITY_STORE_HPP
+#define ENTITY_STORE_HPP
+
+#include "SpatialHash.hpp"
+#include "Sprite.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Handles stay valid while the entity lives. Once it's destroyed its slot's generation moves on, so
+// an old handle is recognized as dead even after the slot is reused.
+struct EntityHandle {
+  uint32_t slot = UINT32_MAX;
+  uint32_t generation = 0;
+};
+
+// Entities stored as a structure of arrays. Every component array is densely packed and indexed the
+// same way, destroying an entity moves the last one into its place, so systems run as flat loops
+// over contiguous floats that the compiler can vectorize.
+class EntityStore {
+public:
+  EntityHandle Create(glm::vec2 position, uint32_t sprite_id, glm::vec3 color = {1.0f, 1.0f, 1.0f}, uint32_t layer = 0);
+  bool Destroy(EntityHandle handle);
+  bool Alive(EntityHandle handle) const;
+  size_t Size() const;
+  void Clear();
+  void Reserve(size_t count);
+
+  glm::vec2 GetPosition(EntityHandle handle) const;
+  void SetPosition(EntityHandle handle, glm::vec2 position);
+  void SetVelocity(EntityHandle handle, glm::vec2 velocity);
+  void SetSprite(EntityHandle handle, uint32_t sprite_id);
+  void SetColor(EntityHandle handle, glm::vec3 color);
+  void SetLayer(EntityHandle handle, uint32_t layer);
+
+  // Moves every entity by its velocity, the position before the step is kept for interpolation
+  void Integrate(float dt);
+  // Keeps every entity's bounds in the hash current, ids are handle slots. Bounds cover both the previous
+  // and the current position since the renderer draws anywhere in between.
+  void UpdateSpatialHash(SpatialHash& hash, const std::vector<SpriteFrame>& frames) const;
+  // Output stage, writes one sprite per entity straight into out (resized to Size(), capacity is reused)
+  void WriteSprites(std::vector<Sprite>& out, const std::vector<SpriteFrame>& frames) const;
+  // Same, but only for the given slots, e.g. the ones a SpatialHash query returned
+  void WriteSprites(std::vector<Sprite>& out, const std::vector<SpriteFrame>& frames, const std::vector<uint32_t>& slots) const;
+
+protected:
+  struct Slot {
+    uint32_t dense = UINT32_MAX;
+    uint32_t generation = 0;
+  };
+
+  // UINT32_MAX for dead handles
+  uint32_t DenseIndex(EntityHandle handle) const;
+  void WriteSprite(Sprite& s, uint32_t dense, const std::vector<SpriteFrame>& frames) const;
+
+  // Dense components
+  std::vector<float> _pos_x;
+  std::vector<float> _pos_y;
+  std::vector<float> _prev_x;
+  std::vector<float> _prev_y;
+  std::vector<float> _vel_x;
+  std::vector<float> _vel_y;
+  std::vector<uint32_t> _sprite;
+  std::vector<glm::vec3> _color;
+  std::vector<uint32_t> _layer;
+  std::vector<uint32_t> _dense_to_slot;
+
+  // Sparse handle table
+  std::vector<Slot> _slots;
+  std::vector<uint32_t> _free_slots;
+};
+
+#endif
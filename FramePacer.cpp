@@ -0,0 +1,88 @@
+#include "FramePacer.hpp"
+
+#include <algorithm>
+#include <thread>
+
+// Even with a well behaved scheduler a wakeup can be this late, always spin at least that long
+static const double MIN_SPIN_NS = 200000;
+static const double MAX_SPIN_NS = 2000000;
+// Smoothing for the exponential moving averages, ~20 frames of memory
+static const double SMOOTHING = 0.05;
+
+FramePacer::FramePacer(double target_fps) : _sleep_overshoot_ns(MIN_SPIN_NS) {
+  SetTargetFps(target_fps);
+}
+
+void FramePacer::SetTargetFps(double target_fps) {
+  if (target_fps > 0)
+    _interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / target_fps));
+  else
+    _interval = Clock::duration::zero();
+
+  _started = false;
+}
+
+double FramePacer::TargetFps() const {
+  if (_interval == Clock::duration::zero()) return 0;
+  return 1.0 / std::chrono::duration<double>(_interval).count();
+}
+
+void FramePacer::Reset() {
+  _started = false;
+}
+
+uint64_t FramePacer::MissedDeadlines() const {
+  return _missed_deadlines;
+}
+
+double FramePacer::SmoothedFrameMs() const {
+  return _smoothed_frame_ms;
+}
+
+void FramePacer::SleepUntil(Clock::time_point deadline) {
+  double spin_ns = std::clamp(_sleep_overshoot_ns * 2, MIN_SPIN_NS, MAX_SPIN_NS);
+  auto sleep_until = deadline - std::chrono::nanoseconds(static_cast<int64_t>(spin_ns));
+
+  auto now = Clock::now();
+  if (sleep_until > now) {
+    std::this_thread::sleep_until(sleep_until);
+
+    double overshoot = std::chrono::duration<double, std::nano>(Clock::now() - sleep_until).count();
+    _sleep_overshoot_ns += (std::max(overshoot, 0.0) - _sleep_overshoot_ns) * SMOOTHING;
+  }
+
+  while (Clock::now() < deadline) {
+    std::this_thread::yield();
+  }
+}
+
+void FramePacer::Wait() {
+  if (_interval != Clock::duration::zero()) {
+    auto now = Clock::now();
+
+    if (!_started) {
+      _deadline = now + _interval;
+      _started = true;
+    }
+
+    if (now < _deadline) {
+      SleepUntil(_deadline);
+    } else {
+      _missed_deadlines++;
+    }
+
+    // Deadlines advance by whole intervals so small errors don't accumulate into drift. After a long
+    // stall the schedule is restarted instead of rushing out frames to catch up.
+    _deadline += _interval;
+    if (_deadline < Clock::now())
+      _deadline = Clock::now() + _interval;
+  }
+
+  auto now = Clock::now();
+  if (_last_frame != Clock::time_point()) {
+    double frame_ms = std::chrono::duration<double, std::milli>(now - _last_frame).count();
+    if (_smoothed_frame_ms == 0) _smoothed_frame_ms = frame_ms;
+    else _smoothed_frame_ms += (frame_ms - _smoothed_frame_ms) * SMOOTHING;
+  }
+  _last_frame = now;
+}
@@ -0,0 +1,37 @@
+#ifndef FRAME_PACER_HPP
+#define FRAME_PACER_HPP
+
+#include <chrono>
+#include <cstdint>
+
+// Holds the frame loop to a target rate without burning a core. Most of the interval is slept away,
+// the last stretch is spun so the OS scheduler's wakeup slop doesn't land on the frame.
+class FramePacer {
+public:
+  explicit FramePacer(double target_fps = 0);
+  // 0 turns pacing off, Wait() then only keeps the frame time estimate up to date
+  void SetTargetFps(double target_fps);
+  double TargetFps() const;
+  // Call once per frame, blocks until the frame's deadline
+  void Wait();
+  // Forgets the current deadline, e.g. after a stall that shouldn't count as a miss
+  void Reset();
+  uint64_t MissedDeadlines() const;
+  double SmoothedFrameMs() const;
+
+protected:
+  using Clock = std::chrono::steady_clock;
+
+  void SleepUntil(Clock::time_point deadline);
+
+  Clock::duration _interval = Clock::duration::zero();
+  Clock::time_point _deadline;
+  Clock::time_point _last_frame;
+  bool _started = false;
+  // How far past the requested time sleep_for tends to return, decides when to switch to spinning
+  double _sleep_overshoot_ns;
+  double _smoothed_frame_ms = 0;
+  uint64_t _missed_deadlines = 0;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef FRAME_SNAPSHOT_HPP
+#define FRAME_SNAPSHOT_HPP
+
+#include "GpuSprite.hpp"
+#include "Sprite.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Tilemap;
+
+struct Camera {
+  glm::vec2 position = {0.0f, 0.0f}; // bottom left corner in world units
+  glm::vec2 size = {1280.0f, 720.0f};
+};
+
+// Everything the renderer needs for one frame. The game thread fills one in and hands it over, after that
+// it is never modified, so the render thread can read it without locking.
+struct FrameSnapshot {
+  uint64_t tick = 0;
+  // When this tick was due on TickClockNow(), the renderer blends from the previous tick's state to
+  // this one over the following tick_length nanoseconds. A tick_length of 0 draws the current state as is.
+  int64_t tick_time = 0;
+  int64_t tick_length = 0;
+  Camera previous_camera;
+  Camera camera;
+  std::vector<Sprite> sprites;
+  // Sprites left out of the list because they were nowhere near the camera
+  size_t culled_sprites = 0;
+  // Drawn under the sprites, the map itself is shared and edited through Tilemap::SetTile
+  std::shared_ptr<Tilemap> tilemap;
+  // Large sprite sets that stay on the GPU, uploaded once per set and culled by a compute pass every frame.
+  // Drawn between the tiles and the sprites above, replace the pointer to change them.
+  std::shared_ptr<const std::vector<GpuSprite>> gpu_sprites;
+};
+
+#endif
@@ -0,0 +1,128 @@
+#include "FrameStats.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+
+FrameStats::FrameStats(size_t window_size) : _window_size(std::max<size_t>(window_size, 1)) {
+  for (auto& m : _metrics) m.window.resize(_window_size);
+}
+
+const char* FrameStats::MetricName(FrameMetric metric) {
+  switch (metric) {
+    case FrameMetric::CpuFrame: return "cpu frame";
+    case FrameMetric::FenceWait: return "fence wait";
+    case FrameMetric::Acquire: return "acquire";
+    case FrameMetric::Present: return "present";
+    default: return "unknown";
+  }
+}
+
+unsigned FrameStats::BucketIndex(uint64_t us) {
+  if (us < SUB_BUCKETS) return static_cast<unsigned>(us);
+
+  unsigned msb = 63 - __builtin_clzll(us);
+  unsigned shift = msb - 4; // keeps the top 5 bits, the leading one plus 4 bits of sub-bucket
+  unsigned index = (shift + 1) * SUB_BUCKETS + static_cast<unsigned>((us >> shift) - SUB_BUCKETS);
+
+  return std::min(index, BUCKET_COUNT - 1);
+}
+
+uint64_t FrameStats::BucketLowerBound(unsigned index) {
+  if (index < SUB_BUCKETS) return index;
+
+  unsigned shift = index / SUB_BUCKETS - 1;
+  return static_cast<uint64_t>(index % SUB_BUCKETS + SUB_BUCKETS) << shift;
+}
+
+void FrameStats::Record(FrameMetric metric, double ms) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  MetricData& m = _metrics[static_cast<size_t>(metric)];
+
+  m.window[m.next] = static_cast<float>(ms);
+  m.next = (m.next + 1) % _window_size;
+  m.count = std::min(m.count + 1, _window_size);
+
+  m.histogram[BucketIndex(static_cast<uint64_t>(std::max(ms, 0.0) * 1000.0))]++;
+  m.total++;
+}
+
+FrameMetricSummary FrameStats::Summarize(FrameMetric metric) const {
+  std::vector<float> samples;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    const MetricData& m = _metrics[static_cast<size_t>(metric)];
+    samples.assign(m.window.begin(), m.window.begin() + m.count);
+  }
+
+  FrameMetricSummary summary;
+  summary.samples = samples.size();
+  if (samples.empty()) return summary;
+
+  std::sort(samples.begin(), samples.end());
+  // Nearest rank, so p99 of a 600 frame window is an actual frame
+  auto percentile = [&samples](double p) {
+    size_t rank = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+    return static_cast<double>(samples[rank]);
+  };
+
+  summary.p50 = percentile(0.50);
+  summary.p95 = percentile(0.95);
+  summary.p99 = percentile(0.99);
+  summary.max = samples.back();
+
+  return summary;
+}
+
+void FrameStats::PrintSummary(std::ostream& out) const {
+  auto flags = out.flags();
+  out << std::fixed << std::setprecision(2);
+
+  for (size_t i = 0; i < _metrics.size(); ++i) {
+    FrameMetric metric = static_cast<FrameMetric>(i);
+    FrameMetricSummary s = Summarize(metric);
+    if (s.samples == 0) continue;
+
+    out << MetricName(metric) << ": p50 " << s.p50 << "ms p95 " << s.p95 << "ms p99 " << s.p99 
+      << "ms max " << s.max << "ms" << std::endl;
+  }
+
+  out.flags(flags);
+}
+
+void FrameStats::PrintHistogram(std::ostream& out) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  auto flags = out.flags();
+  out << std::fixed << std::setprecision(3);
+
+  for (size_t i = 0; i < _metrics.size(); ++i) {
+    const MetricData& m = _metrics[i];
+    if (m.total == 0) continue;
+
+    out << MetricName(static_cast<FrameMetric>(i)) << " (" << m.total << " samples)" << std::endl;
+
+    uint64_t peak = *std::max_element(m.histogram.begin(), m.histogram.end());
+    uint64_t cumulative = 0;
+    for (unsigned b = 0; b < BUCKET_COUNT; ++b) {
+      if (m.histogram[b] == 0) continue;
+      cumulative += m.histogram[b];
+
+      out << "  " << std::setw(10) << BucketLowerBound(b) / 1000.0 << "ms " << std::setw(8) << m.histogram[b] 
+        << " " << std::setw(7) << std::setprecision(2) << 100.0 * cumulative / m.total << "% " 
+        << std::string(static_cast<size_t>(40 * m.histogram[b] / peak), '#') << std::setprecision(3) << std::endl;
+    }
+  }
+
+  out.flags(flags);
+}
+
+void FrameStats::Reset() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (auto& m : _metrics) {
+    m.next = 0;
+    m.count = 0;
+    m.histogram.fill(0);
+    m.total = 0;
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef FRAME_STATS_HPP
+#define FRAME_STATS_HPP
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+enum class FrameMetric {
+  CpuFrame,
+  FenceWait,
+  Acquire,
+  Present,
+  Count
+};
+
+struct FrameMetricSummary {
+  size_t samples = 0;
+  double p50 = 0;
+  double p95 = 0;
+  double p99 = 0;
+  double max = 0;
+};
+
+// Keeps the last few hundred samples of each metric for percentiles and a log-linear histogram of
+// every sample since the last reset. Averages hide the hitches, so this never reports one.
+class FrameStats {
+public:
+  explicit FrameStats(size_t window_size = 600);
+  void Record(FrameMetric metric, double ms);
+  FrameMetricSummary Summarize(FrameMetric metric) const;
+  void PrintSummary(std::ostream& out) const;
+  void PrintHistogram(std::ostream& out) const;
+  void Reset();
+  static const char* MetricName(FrameMetric metric);
+
+protected:
+  // 16 linear sub-buckets per power of two of microseconds, so every bucket is within ~6% of its value
+  static const unsigned SUB_BUCKETS = 16;
+  static const unsigned BUCKET_COUNT = 24 * SUB_BUCKETS;
+  static unsigned BucketIndex(uint64_t us);
+  static uint64_t BucketLowerBound(unsigned index);
+
+  struct MetricData {
+    std::vector<float> window; // ring buffer, newest sample at (next - 1)
+    size_t next = 0;
+    size_t count = 0;
+    std::array<uint64_t, BUCKET_COUNT> histogram = {};
+    uint64_t total = 0;
+  };
+
+  // Samples come from the render loop while dumps can be requested from anywhere
+  mutable std::mutex _mutex;
+  size_t _window_size;
+  std::array<MetricData, static_cast<size_t>(FrameMetric::Count)> _metrics;
+};
+
+#endif
@@ -1,5 +1,9 @@
 #include "Game.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
 bool Game::Init(unsigned window_width, unsigned window_height, const char* window_caption) {
   if (!_window.Init(window_width, window_height, window_caption))
     return false;
@@ -8,7 +12,78 @@ bool Game::Init(unsigned window_width, unsigned window_height, const char* windo
 }
 
 void Game::Update() {
-  _window.Poll();
+  PROFILE_SCOPE("GameUpdate");
+
+  _window.PollEvents();
+
+  unsigned ticks = _timestep.Advance(TickClockNow());
+  for (unsigned i = 0; i < ticks; ++i) {
+    Simulate();
+  }
+
+  if (ticks > 0)
+    PublishSnapshot();
+
+  // Nothing changes until the next tick is due, events get polled again then
+  int64_t untilNextTick = _timestep.NextTickTime() - TickClockNow();
+  if (untilNextTick > 0)
+    std::this_thread::sleep_for(std::chrono::nanoseconds(untilNextTick));
+}
+
+void Game::Simulate() {
+  PROFILE_SCOPE("Simulate");
+
+  _previous_camera = _camera;
+  _entities.Integrate(static_cast<float>(_timestep.TickLength()) / 1e9f);
+  _entities.UpdateSpatialHash(_spatial_hash, _sprite_frames);
+}
+
+void Game::PublishSnapshot() {
+  FrameSnapshot& snapshot = _window.BeginSnapshot();
+  snapshot.tick = _timestep.Tick();
+  snapshot.tick_time = _timestep.NextTickTime() - _timestep.TickLength();
+  snapshot.tick_length = _timestep.TickLength();
+  snapshot.previous_camera = _previous_camera;
+  snapshot.camera = _camera;
+  // The renderer blends between the two cameras, anything visible from either one has to be in the list
+  glm::vec2 viewMin = glm::min(_previous_camera.position, _camera.position);
+  glm::vec2 viewMax = glm::max(_previous_camera.position + _previous_camera.size, _camera.position + _camera.size);
+
+  _visible_entities.clear();
+  {
+    PROFILE_SCOPE("CullSprites");
+    _spatial_hash.Query(viewMin, viewMax, _visible_entities);
+  }
+  // Hash order depends on the grid, sorting keeps the draw order of overlapping sprites stable
+  std::sort(_visible_entities.begin(), _visible_entities.end());
+
+  // Written straight into the snapshot, which keeps its capacity, so publishing doesn't allocate or copy twice
+  _entities.WriteSprites(snapshot.sprites, _sprite_frames, _visible_entities);
+  snapshot.culled_sprites = _entities.Size() - snapshot.sprites.size();
+  _window.PublishSnapshot();
+}
+
+uint32_t Game::AddSpriteFrame(const SpriteFrame& frame) {
+  _sprite_frames.push_back(frame);
+  return static_cast<uint32_t>(_sprite_frames.size() - 1);
+}
+
+EntityHandle Game::CreateEntity(glm::vec2 position, uint32_t sprite_id, glm::vec3 color, uint32_t layer) {
+  EntityHandle handle = _entities.Create(position, sprite_id, color, layer);
+
+  glm::vec2 size = (sprite_id < _sprite_frames.size()) ? _sprite_frames[sprite_id].size : glm::vec2(0.0f, 0.0f);
+  _spatial_hash.Update(handle.slot, position, position + size);
+
+  return handle;
+}
+
+void Game::DestroyEntity(EntityHandle handle) {
+  if (_entities.Destroy(handle))
+    _spatial_hash.Remove(handle.slot);
+}
+
+EntityStore& Game::GetEntities() {
+  return _entities;
 }
 
 bool Game::GameEnding() {
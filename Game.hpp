@@ -1,8 +1,14 @@
 #ifndef GAME_HPP
 #define GAME_HPP
 
+#include "EntityStore.hpp"
+#include "Tick.hpp"
 #include "Window.hpp"
 
+#include <vector>
+
+// Runs on the main thread: pumps window events, steps the world in fixed ticks and publishes a
+// snapshot of it for the render thread.
 class Game {
 public:
   Game() = default;
@@ -11,8 +17,28 @@ public:
   void Update();
   bool GameEnding();
 
+  // Sprite ids entities draw with, numbered in the order they were added
+  uint32_t AddSpriteFrame(const SpriteFrame& frame);
+  // Entities go into the spatial hash right away and leave it when destroyed. Create and destroy them
+  // here rather than through GetEntities so the two stay in step.
+  EntityHandle CreateEntity(glm::vec2 position, uint32_t sprite_id, glm::vec3 color = {1.0f, 1.0f, 1.0f}, uint32_t layer = 0);
+  void DestroyEntity(EntityHandle handle);
+  // For moving and restyling entities, the hash catches up every tick
+  EntityStore& GetEntities();
+
 protected:
+  // One fixed step of the simulation, only ever called with a constant dt
+  void Simulate();
+  void PublishSnapshot();
+
   Window _window;
+  FixedTimestep _timestep;
+  Camera _previous_camera;
+  Camera _camera;
+  EntityStore _entities;
+  SpatialHash _spatial_hash;
+  std::vector<uint32_t> _visible_entities;
+  std::vector<SpriteFrame> _sprite_frames; // indexed by the entities' sprite ids
 };
 
 #endif
@@ -0,0 +1,41 @@
+#include "GpuSprite.hpp"
+
+VkVertexInputBindingDescription GpuSprite::GetBindingDescription() {
+  VkVertexInputBindingDescription bindingDescription = {};
+  bindingDescription.binding = 0;
+  bindingDescription.stride = sizeof(GpuSprite);
+  bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+  return bindingDescription;
+}
+
+std::array<VkVertexInputAttributeDescription, 5> GpuSprite::GetAttributeDescriptions() {
+  std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions = {};
+
+  attributeDescriptions[0].binding = 0;
+  attributeDescriptions[0].location = 0;
+  attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+  attributeDescriptions[0].offset = offsetof(GpuSprite, pos);
+
+  attributeDescriptions[1].binding = 0;
+  attributeDescriptions[1].location = 1;
+  attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
+  attributeDescriptions[1].offset = offsetof(GpuSprite, size);
+
+  attributeDescriptions[2].binding = 0;
+  attributeDescriptions[2].location = 2;
+  attributeDescriptions[2].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+  attributeDescriptions[2].offset = offsetof(GpuSprite, uv);
+
+  attributeDescriptions[3].binding = 0;
+  attributeDescriptions[3].location = 3;
+  attributeDescriptions[3].format = VK_FORMAT_R8G8B8A8_UNORM;
+  attributeDescriptions[3].offset = offsetof(GpuSprite, color);
+
+  attributeDescriptions[4].binding = 0;
+  attributeDescriptions[4].location = 4;
+  attributeDescriptions[4].format = VK_FORMAT_R32_UINT;
+  attributeDescriptions[4].offset = offsetof(GpuSprite, texture);
+
+  return attributeDescriptions;
+}
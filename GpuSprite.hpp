@@ -0,0 +1,23 @@
+#ifndef GPU_SPRITE_HPP
+#define GPU_SPRITE_HPP
+
+#include "VulkanHeaders.hpp"
+
+#include <array>
+#include <cstdint>
+
+// One sprite of a set that lives on the GPU. Matches the std430 layout in shaders/cull.comp and is also
+// the per-instance vertex input of shaders/instanced.vert, so culled sprites are copied without repacking.
+struct GpuSprite {
+  glm::vec2 pos;
+  glm::vec2 size;
+  glm::vec4 uv; // offset in xy, extent in zw
+  uint32_t color; // RGBA8, red in the lowest byte
+  uint32_t texture; // from Renderer::CreateTexture rather than a page, always the atlas without bindless textures
+  uint32_t padding[2]; // std430 rounds the struct up to 16 bytes
+
+  static VkVertexInputBindingDescription GetBindingDescription();
+  static std::array<VkVertexInputAttributeDescription, 5> GetAttributeDescriptions();
+};
+
+#endif
@@ -0,0 +1,410 @@
+#include "PipelineManager.hpp"
+
+#include "GpuSprite.hpp"
+#include "Profiler.hpp"
+#include "Resource.hpp"
+#include "ShaderTables.hpp"
+#include "Vertex.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+bool PipelineState::operator==(const PipelineState& other) const {
+  return vertex == other.vertex && fragment == other.fragment && blend == other.blend
+    && topology == other.topology && cull_mode == other.cull_mode && depth_test == other.depth_test
+    && depth_write == other.depth_write;
+}
+
+size_t PipelineStateHash::operator()(const PipelineState& state) const {
+  // FNV-1a over the fields rather than the bytes, the struct has padding
+  uint64_t fields[] = {
+    static_cast<uint64_t>(state.vertex), static_cast<uint64_t>(state.fragment), static_cast<uint64_t>(state.blend),
+    static_cast<uint64_t>(state.topology), static_cast<uint64_t>(state.cull_mode), static_cast<uint64_t>(state.depth_test),
+    static_cast<uint64_t>(state.depth_write)
+  };
+
+  uint64_t hash = 14695981039346656037ull;
+  for (uint64_t field : fields) {
+    hash ^= field;
+    hash *= 1099511628211ull;
+  }
+  return static_cast<size_t>(hash);
+}
+
+bool InitShaderModule(VkDevice device, VkShaderModule& shader_module, Resource code) {
+  // The code goes to the driver straight from the embedded blob, which add_resource aligns
+  if (code.empty() || reinterpret_cast<uintptr_t>(code.data()) % alignof(uint32_t) != 0) {
+    std::cerr << "Failed to create shader module, code is missing or misaligned" << std::endl;
+    return false;
+  }
+
+  VkShaderModuleCreateInfo createInfo = {};
+  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.codeSize = code.size();
+  createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+  if (vkCreateShaderModule(device, &createInfo, nullptr, &shader_module) != VK_SUCCESS) {
+    std::cerr << "Failed to create shader module" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+PipelineManager::PipelineManager() {
+}
+
+PipelineManager::~PipelineManager() {
+  StopWorker();
+}
+
+bool PipelineManager::Init(VkDevice device, const std::string& cache_path) {
+  _device = device;
+  _cache_path = cache_path;
+
+  // The vertex formats pack data in ways the shaders can't express, so they are written by hand and
+  // checked against what the shaders read instead
+  auto vertexAttributes = Vertex::GetAttributeDescriptions();
+  auto packedAttributes = PackedVertex::GetAttributeDescriptions();
+  auto instanceAttributes = GpuSprite::GetAttributeDescriptions();
+
+  if (!CheckVertexInputs(shader_tables::sprite_vert, vertexAttributes.data(), static_cast<uint32_t>(vertexAttributes.size()))
+    || !CheckVertexInputs(shader_tables::sprite_packed_vert, packedAttributes.data(), static_cast<uint32_t>(packedAttributes.size()))
+    || !CheckVertexInputs(shader_tables::instanced_vert, instanceAttributes.data(), static_cast<uint32_t>(instanceAttributes.size()))) {
+    std::cerr << "Failed to create pipelines, vertex formats don't match the shaders" << std::endl;
+    return false;
+  }
+
+  // Indexed by VertexShader and FragmentShader
+  if (!InitShaderModule(_device, _vertex_shaders[0], LOAD_RESOURCE(sprite_vert_spv))
+    || !InitShaderModule(_device, _vertex_shaders[1], LOAD_RESOURCE(sprite_packed_vert_spv))
+    || !InitShaderModule(_device, _vertex_shaders[2], LOAD_RESOURCE(instanced_vert_spv))
+    || !InitShaderModule(_device, _fragment_shaders[0], LOAD_RESOURCE(sprite_frag_spv))
+    || !InitShaderModule(_device, _fragment_shaders[1], LOAD_RESOURCE(sprite_bindless_frag_spv))
+    || !InitShaderModule(_device, _fragment_shaders[2], LOAD_RESOURCE(sprite_cutout_frag_spv))
+    || !InitShaderModule(_device, _fragment_shaders[3], LOAD_RESOURCE(sprite_bindless_cutout_frag_spv))) {
+    return false;
+  }
+
+  // Data from another driver or device is ignored by the driver, the cache just starts out empty then
+  std::vector<char> cacheData;
+  std::ifstream file(_cache_path, std::ios::binary | std::ios::ate);
+  if (file) {
+    cacheData.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(cacheData.data(), cacheData.size()))
+      cacheData.clear();
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = cacheData.size();
+  cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+  if (vkCreatePipelineCache(_device, &cacheInfo, nullptr, &_cache) != VK_SUCCESS) {
+    std::cerr << "Failed to create pipeline cache" << std::endl;
+    return false;
+  }
+
+  _thread = std::thread(&PipelineManager::WorkerLoop, this);
+  return true;
+}
+
+void PipelineManager::Destroy() {
+  if (_device == VK_NULL_HANDLE) return;
+
+  StopWorker();
+  SaveCache();
+
+  for (uint32_t i = 0; i < _entry_count; i++)
+    vkDestroyPipeline(_device, _entries[i].pipeline, nullptr);
+  for (VkShaderModule shader : _vertex_shaders)
+    vkDestroyShaderModule(_device, shader, nullptr);
+  for (VkShaderModule shader : _fragment_shaders)
+    vkDestroyShaderModule(_device, shader, nullptr);
+  vkDestroyPipelineCache(_device, _cache, nullptr);
+
+  _device = VK_NULL_HANDLE;
+}
+
+void PipelineManager::SetTarget(VkRenderPass render_pass, VkPipelineLayout layout) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (render_pass == _render_pass && layout == _layout) return;
+
+  // Nothing can still be building against the old target once it's swapped out
+  _queue.clear();
+  _created.wait(lock, [this]() { return _building == 0; });
+
+  _render_pass = render_pass;
+  _layout = layout;
+
+  // Whatever was in use before is wanted again, so it goes straight back on the queue
+  for (uint32_t i = 0; i < _entry_count; i++) {
+    Entry& entry = _entries[i];
+    PipelineStatus status = entry.status;
+    vkDestroyPipeline(_device, entry.pipeline, nullptr);
+    entry.pipeline = VK_NULL_HANDLE;
+    entry.status = PipelineStatus::Unrequested;
+
+    if (status != PipelineStatus::Unrequested)
+      Request(i);
+  }
+}
+
+int32_t PipelineManager::Register(const PipelineState& state) {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  auto it = _ids.find(state);
+  if (it != _ids.end()) return static_cast<int32_t>(it->second);
+
+  uint32_t id = _entry_count;
+  if (id == MAX_PIPELINES) {
+    std::cerr << "Failed to register pipeline, all " << MAX_PIPELINES << " ids are in use" << std::endl;
+    return -1;
+  }
+
+  _entries[id].state = state;
+  _ids.emplace(state, id);
+  // Get reads the entries without the lock, the count is what publishes this one
+  _entry_count.store(id + 1, std::memory_order_release);
+  return static_cast<int32_t>(id);
+}
+
+VkPipeline PipelineManager::Get(uint32_t id) {
+  if (id >= _entry_count.load(std::memory_order_acquire)) return VK_NULL_HANDLE;
+
+  Entry& entry = _entries[id];
+  PipelineStatus status = entry.status.load(std::memory_order_acquire);
+  if (status == PipelineStatus::Ready)
+    return entry.pipeline.load(std::memory_order_relaxed);
+
+  if (status == PipelineStatus::Unrequested) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Request(id);
+  }
+  return VK_NULL_HANDLE;
+}
+
+VkPipeline PipelineManager::Wait(uint32_t id) {
+  if (id >= _entry_count) return VK_NULL_HANDLE;
+
+  PROFILE_SCOPE("WaitForPipeline");
+
+  Entry& entry = _entries[id];
+  std::unique_lock<std::mutex> lock(_mutex);
+  Request(id);
+  _created.wait(lock, [&entry]() {
+    PipelineStatus status = entry.status;
+    return status == PipelineStatus::Ready || status == PipelineStatus::Failed;
+  });
+
+  return entry.pipeline;
+}
+
+void PipelineManager::Request(uint32_t id) {
+  if (_entries[id].status != PipelineStatus::Unrequested) return;
+
+  _entries[id].status = PipelineStatus::Queued;
+  _queue.push_back(id);
+  _wake.notify_one();
+}
+
+void PipelineManager::WorkerLoop() {
+  for (;;) {
+    uint32_t id;
+    PipelineState state;
+    VkRenderPass renderPass;
+    VkPipelineLayout layout;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [this]() { return _stopping || !_queue.empty(); });
+      if (_stopping) return;
+
+      id = _queue.front();
+      _queue.pop_front();
+      state = _entries[id].state;
+      renderPass = _render_pass;
+      layout = _layout;
+      _building++;
+    }
+
+    VkPipeline pipeline = Create(state, renderPass, layout);
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _entries[id].pipeline.store(pipeline, std::memory_order_relaxed);
+      _entries[id].status.store((pipeline != VK_NULL_HANDLE) ? PipelineStatus::Ready : PipelineStatus::Failed,
+        std::memory_order_release);
+      _building--;
+    }
+    _created.notify_all();
+  }
+}
+
+VkPipeline PipelineManager::Create(const PipelineState& state, VkRenderPass render_pass, VkPipelineLayout layout) const {
+  PROFILE_SCOPE("CreatePipeline");
+
+  VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+  shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  shaderStages[0].module = _vertex_shaders[static_cast<size_t>(state.vertex)];
+  shaderStages[0].pName = "main";
+  shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  shaderStages[1].module = _fragment_shaders[static_cast<size_t>(state.fragment)];
+  shaderStages[1].pName = "main";
+
+  // Each vertex shader reads exactly one format
+  VkVertexInputBindingDescription bindingDescription;
+  std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+  switch (state.vertex) {
+    case VertexShader::Sprite: {
+      auto attributes = Vertex::GetAttributeDescriptions();
+      bindingDescription = Vertex::GetBindingDescription();
+      attributeDescriptions.assign(attributes.begin(), attributes.end());
+      break;
+    }
+    case VertexShader::SpritePacked: {
+      auto attributes = PackedVertex::GetAttributeDescriptions();
+      bindingDescription = PackedVertex::GetBindingDescription();
+      attributeDescriptions.assign(attributes.begin(), attributes.end());
+      break;
+    }
+    case VertexShader::Instanced: {
+      // GPU sprites build their quad from per-instance data
+      auto attributes = GpuSprite::GetAttributeDescriptions();
+      bindingDescription = GpuSprite::GetBindingDescription();
+      attributeDescriptions.assign(attributes.begin(), attributes.end());
+      break;
+    }
+  }
+
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+  vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInputInfo.vertexBindingDescriptionCount = 1;
+  vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+  vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+  inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.topology = state.topology;
+  inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+  // Viewport and scissor are dynamic so the pipeline survives swapchain resizes
+  VkPipelineViewportStateCreateInfo viewportState = {};
+  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.viewportCount = 1;
+  viewportState.pViewports = nullptr;
+  viewportState.scissorCount = 1;
+  viewportState.pScissors = nullptr;
+
+  VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+  VkPipelineDynamicStateCreateInfo dynamicState = {};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = 2;
+  dynamicState.pDynamicStates = dynamicStates;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer = {};
+  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.depthClampEnable = VK_FALSE;
+  rasterizer.rasterizerDiscardEnable = VK_FALSE;
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.lineWidth = 1.0f;
+  rasterizer.cullMode = state.cull_mode;
+  rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+  rasterizer.depthBiasEnable = VK_FALSE;
+
+  VkPipelineMultisampleStateCreateInfo multisampling = {};
+  multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.sampleShadingEnable = VK_FALSE;
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+  depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depthStencil.depthTestEnable = state.depth_test ? VK_TRUE : VK_FALSE;
+  depthStencil.depthWriteEnable = state.depth_write ? VK_TRUE : VK_FALSE;
+  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  depthStencil.depthBoundsTestEnable = VK_FALSE;
+  depthStencil.stencilTestEnable = VK_FALSE;
+
+  VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+  colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  colorBlendAttachment.blendEnable = (state.blend != BlendMode::Opaque) ? VK_TRUE : VK_FALSE;
+  colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+  colorBlendAttachment.dstColorBlendFactor = (state.blend == BlendMode::Additive) ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+  colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+  VkPipelineColorBlendStateCreateInfo colorBlending = {};
+  colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colorBlending.logicOpEnable = VK_FALSE;
+  colorBlending.logicOp = VK_LOGIC_OP_COPY;
+  colorBlending.attachmentCount = 1;
+  colorBlending.pAttachments = &colorBlendAttachment;
+
+  VkGraphicsPipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.stageCount = 2;
+  pipelineInfo.pStages = shaderStages;
+  pipelineInfo.pVertexInputState = &vertexInputInfo;
+  pipelineInfo.pInputAssemblyState = &inputAssembly;
+  pipelineInfo.pViewportState = &viewportState;
+  pipelineInfo.pRasterizationState = &rasterizer;
+  pipelineInfo.pMultisampleState = &multisampling;
+  pipelineInfo.pDepthStencilState = &depthStencil;
+  pipelineInfo.pColorBlendState = &colorBlending;
+  pipelineInfo.pDynamicState = &dynamicState;
+  pipelineInfo.layout = layout;
+  pipelineInfo.renderPass = render_pass;
+  pipelineInfo.subpass = 0;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+  // The cache is internally synchronized, so the render thread can keep using it meanwhile
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  if (vkCreateGraphicsPipelines(_device, _cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+    std::cerr << "Failed to create graphics pipeline" << std::endl;
+    return VK_NULL_HANDLE;
+  }
+
+  return pipeline;
+}
+
+void PipelineManager::StopWorker() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _wake.notify_all();
+
+  if (_thread.joinable())
+    _thread.join();
+}
+
+void PipelineManager::SaveCache() const {
+  size_t size = 0;
+  if (vkGetPipelineCacheData(_device, _cache, &size, nullptr) != VK_SUCCESS || size == 0) return;
+
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(_device, _cache, &size, data.data()) != VK_SUCCESS) return;
+
+  // Written next to the old one and moved over it, a crash mid-write leaves the old cache intact
+  std::string tempPath = _cache_path + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), size);
+    if (!file) {
+      std::cerr << "Failed to write pipeline cache: " << tempPath << std::endl;
+      return;
+    }
+  }
+
+  std::remove(_cache_path.c_str());
+  if (std::rename(tempPath.c_str(), _cache_path.c_str()) != 0)
+    std::cerr << "Failed to write pipeline cache: " << _cache_path << std::endl;
+}
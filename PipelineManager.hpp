@@ -0,0 +1,139 @@
+#ifndef PIPELINE_MANAGER_HPP
+#define PIPELINE_MANAGER_HPP
+
+#include "Resource.hpp"
+#include "VulkanHeaders.hpp"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// SPIR-V straight from an embedded resource, used for the compute shaders outside the manager too
+bool InitShaderModule(VkDevice device, VkShaderModule& shader_module, Resource code);
+
+// Vertex shader permutations, each reads one vertex format
+enum class VertexShader : uint8_t {
+  Sprite,       // Vertex
+  SpritePacked, // PackedVertex
+  Instanced     // GpuSprite, one per instance
+};
+
+enum class FragmentShader : uint8_t {
+  Sprite,              // samples the bound texture
+  SpriteBindless,      // picks the texture per fragment
+  SpriteCutout,        // Sprite, discarding texels below half alpha
+  SpriteBindlessCutout // SpriteBindless, discarding texels below half alpha
+};
+
+enum class BlendMode : uint8_t {
+  Opaque,
+  Alpha,
+  Additive
+};
+
+// Everything that tells two graphics pipelines apart. Viewport and scissor are dynamic, the render pass
+// and layout are the same for every pipeline the manager makes. Depth state is ignored by render passes
+// without a depth attachment.
+struct PipelineState {
+  VertexShader vertex = VertexShader::Sprite;
+  FragmentShader fragment = FragmentShader::Sprite;
+  BlendMode blend = BlendMode::Alpha;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+  // Less or equal, so later draws at the same depth still land on top
+  bool depth_test = false;
+  bool depth_write = false;
+
+  bool operator==(const PipelineState& other) const;
+};
+
+struct PipelineStateHash {
+  size_t operator()(const PipelineState& state) const;
+};
+
+// Graphics pipelines created on first use. States are registered once and referred to by a small id
+// afterwards, identical states share an id and a pipeline. The id fits the pipeline field of a
+// RenderQueue key.
+//
+// Pipelines are built on a thread of their own through a VkPipelineCache that is saved to disk, so a
+// state seen for the first time costs nothing on the frame that asks for it. Get returns
+// VK_NULL_HANDLE until the pipeline is ready and callers skip those draws, Wait blocks instead for
+// pipelines that can't be missing, e.g. the ones every frame needs at startup.
+//
+// Register and SetTarget are for the render thread. Get can be called from any thread, including the
+// jobs recording secondary command buffers.
+class PipelineManager {
+public:
+  static const uint32_t MAX_PIPELINES = 256;
+
+  PipelineManager();
+  ~PipelineManager();
+  PipelineManager(const PipelineManager&) = delete;
+  PipelineManager& operator=(const PipelineManager&) = delete;
+
+  // Creates the shader modules and the cache, seeded from cache_path when it holds data for this device
+  bool Init(VkDevice device, const std::string& cache_path);
+  // Writes the cache back and destroys everything, before the device goes
+  void Destroy();
+  // Render pass and layout every pipeline is made for. Pipelines made for the previous ones are
+  // destroyed and rebuilt in the background, ids stay valid. Wait for the frames using them first.
+  void SetTarget(VkRenderPass render_pass, VkPipelineLayout layout);
+
+  // Id of the state's pipeline, -1 once MAX_PIPELINES different states are registered. Nothing is
+  // created until the id is first used.
+  int32_t Register(const PipelineState& state);
+  // The pipeline, or VK_NULL_HANDLE while it's still being created
+  VkPipeline Get(uint32_t id);
+  // Blocks until the pipeline exists, VK_NULL_HANDLE if it couldn't be created
+  VkPipeline Wait(uint32_t id);
+
+protected:
+  enum class PipelineStatus : uint8_t {
+    Unrequested,
+    Queued,
+    Ready,
+    Failed
+  };
+
+  struct Entry {
+    PipelineState state;
+    std::atomic<VkPipeline> pipeline{VK_NULL_HANDLE};
+    std::atomic<PipelineStatus> status{PipelineStatus::Unrequested};
+  };
+
+  // Call with _mutex held
+  void Request(uint32_t id);
+  void WorkerLoop();
+  VkPipeline Create(const PipelineState& state, VkRenderPass render_pass, VkPipelineLayout layout) const;
+  void StopWorker();
+  void SaveCache() const;
+
+  VkDevice _device = VK_NULL_HANDLE;
+  VkPipelineCache _cache = VK_NULL_HANDLE;
+  std::string _cache_path;
+  std::array<VkShaderModule, 3> _vertex_shaders = {};
+  std::array<VkShaderModule, 4> _fragment_shaders = {};
+  VkRenderPass _render_pass = VK_NULL_HANDLE;
+  VkPipelineLayout _layout = VK_NULL_HANDLE;
+
+  std::array<Entry, MAX_PIPELINES> _entries;
+  std::atomic<uint32_t> _entry_count{0};
+  std::unordered_map<PipelineState, uint32_t, PipelineStateHash> _ids;
+
+  std::thread _thread;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _created;
+  std::deque<uint32_t> _queue;
+  uint32_t _building = 0; // pipelines the worker has taken off the queue and not finished yet
+  bool _stopping = false;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+static const size_t EVENTS_PER_THREAD = 1 << 16;
+static const uint32_t GPU_TRACK_ID = 0;
+
+struct ProfileEvent {
+  const char* name;
+  int64_t start_ns;
+  int64_t duration_ns;
+};
+
+struct ProfileTrack {
+  ProfileTrack(uint32_t id) : id(id), events(EVENTS_PER_THREAD) {}
+  uint32_t id;
+  std::vector<ProfileEvent> events;
+  // Only the owning thread writes, head is published so readers know how far the buffer is valid
+  std::atomic<uint64_t> head{0};
+
+  void Push(const char* name, int64_t start_ns, int64_t end_ns) {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    events[h % events.size()] = {name, start_ns, end_ns - start_ns};
+    head.store(h + 1, std::memory_order_release);
+  }
+};
+
+// Tracks are never freed so a thread exiting can't pull a buffer out from under WriteChromeTrace
+static std::mutex tracks_mutex;
+static std::vector<std::unique_ptr<ProfileTrack>> tracks;
+
+static ProfileTrack* RegisterTrack() {
+  std::lock_guard<std::mutex> lock(tracks_mutex);
+  tracks.emplace_back(new ProfileTrack(static_cast<uint32_t>(tracks.size())));
+  return tracks.back().get();
+}
+
+static ProfileTrack* GpuTrack() {
+  // The first track registered is always the GPU one
+  static ProfileTrack* track = RegisterTrack();
+  return track;
+}
+
+static ProfileTrack* ThreadTrack() {
+  GpuTrack();
+  thread_local ProfileTrack* track = RegisterTrack();
+  return track;
+}
+
+std::atomic<bool> Profiler::_enabled{false};
+
+void Profiler::SetEnabled(bool enabled) {
+  _enabled.store(enabled, std::memory_order_relaxed);
+}
+
+int64_t Profiler::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::RecordCpu(const char* name, int64_t start_ns, int64_t end_ns) {
+  ThreadTrack()->Push(name, start_ns, end_ns);
+}
+
+void Profiler::RecordGpu(const char* name, int64_t start_ns, int64_t end_ns) {
+  GpuTrack()->Push(name, start_ns, end_ns);
+}
+
+void Profiler::Clear() {
+  std::lock_guard<std::mutex> lock(tracks_mutex);
+  for (auto& track : tracks) track->head.store(0, std::memory_order_release);
+}
+
+bool Profiler::WriteChromeTrace(const char* path) {
+  std::ofstream out(path);
+  if (!out.is_open()) {
+    std::cerr << "Failed to open trace file " << path << std::endl;
+    return false;
+  }
+
+  GpuTrack();
+
+  std::lock_guard<std::mutex> lock(tracks_mutex);
+
+  // Timestamps are in microseconds, keep the nanosecond digits
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for (const auto& track : tracks) {
+    out << (first ? "" : ",") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track->id 
+      << ",\"args\":{\"name\":\"" << ((track->id == GPU_TRACK_ID) ? "GPU" : "CPU ") ;
+    if (track->id != GPU_TRACK_ID) out << track->id;
+    out << "\"}}";
+    first = false;
+
+    uint64_t head = track->head.load(std::memory_order_acquire);
+    uint64_t count = std::min<uint64_t>(head, track->events.size());
+    for (uint64_t i = head - count; i < head; ++i) {
+      const ProfileEvent& e = track->events[i % track->events.size()];
+      out << ",{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << track->id 
+        << ",\"ts\":" << e.start_ns / 1000.0 << ",\"dur\":" << e.duration_ns / 1000.0 << "}";
+    }
+  }
+  out << "]}" << std::endl;
+
+  std::cout << "Wrote trace to " << path << std::endl;
+  return true;
+}
@@ -0,0 +1,47 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// Collects CPU spans and GPU timings and writes them out as Chrome trace JSON (chrome://tracing, Perfetto).
+// Every thread records into its own ring buffer so recording never takes a lock. Span names must
+// outlive the profiler, in practice they are string literals.
+class Profiler {
+public:
+  static void SetEnabled(bool enabled);
+  static bool Enabled() { return _enabled.load(std::memory_order_relaxed); }
+  // Nanoseconds on the steady clock, every timestamp handed to the profiler is in this domain
+  static int64_t Now();
+  static void RecordCpu(const char* name, int64_t start_ns, int64_t end_ns);
+  // GPU spans go to their own track, they must already be converted to the CPU clock
+  static void RecordGpu(const char* name, int64_t start_ns, int64_t end_ns);
+  // Spans still being written while this runs may come out garbled, best called when the threads are idle
+  static bool WriteChromeTrace(const char* path);
+  static void Clear();
+
+private:
+  static std::atomic<bool> _enabled;
+};
+
+class ProfileScope {
+public:
+  explicit ProfileScope(const char* name) : _name(name), _start(Profiler::Enabled() ? Profiler::Now() : -1) {}
+  ~ProfileScope() { if (_start >= 0) Profiler::RecordCpu(_name, _start, Profiler::Now()); }
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+  const char* _name;
+  int64_t _start;
+};
+
+#ifdef DISABLE_PROFILING
+#define PROFILE_SCOPE(name)
+#else
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(_profile_scope_, __LINE__)(name)
+#endif
+
+#endif
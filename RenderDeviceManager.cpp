@@ -18,8 +18,9 @@ RenderDevice::RenderDevice(VkPhysicalDevice device, RenderDeviceManager* parent)
   int i = 0;
   for (const auto& queueFamily : queueFamilies) {
     VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(_device, i, surface, &presentSupport);
-    _queue_proprties.emplace_back(i++, queueFamily.queueFlags, presentSupport);
+    if (surface != VK_NULL_HANDLE)
+      vkGetPhysicalDeviceSurfaceSupportKHR(_device, i, surface, &presentSupport);
+    _queue_proprties.emplace_back(i++, queueFamily.queueFlags, presentSupport, queueFamily.timestampValidBits);
   }
 
   _device_properties = new VkPhysicalDeviceProperties;
@@ -32,6 +33,12 @@ RenderDevice::RenderDevice(VkPhysicalDevice device, RenderDeviceManager* parent)
   _device_extensions.resize(extensionCount);
   vkEnumerateDeviceExtensionProperties(_device, nullptr, &extensionCount, _device_extensions.data());
 
+  // Headless renderers have no surface to query
+  if (surface == VK_NULL_HANDLE) {
+    PrintSupportedOperations();
+    return;
+  }
+
   vkGetPhysicalDeviceSurfaceCapabilitiesKHR(_device, surface, &_swapchain_properties.capabilities);
 
   uint32_t formatCount;
@@ -111,6 +118,58 @@ unsigned RenderDevice::MaxTextureSize() const {
   return _device_properties->limits.maxImageDimension2D;
 }
 
+bool RenderDevice::SupportsBindlessTextures() const {
+  if (!SupportsExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+    return false;
+
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+  indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+  VkPhysicalDeviceFeatures2 features = {};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &indexingFeatures;
+  vkGetPhysicalDeviceFeatures2(_device, &features);
+
+  // Update after bind lets new textures go into the array while frames using it are in flight
+  return indexingFeatures.shaderSampledImageArrayNonUniformIndexing 
+    && indexingFeatures.descriptorBindingPartiallyBound 
+    && indexingFeatures.runtimeDescriptorArray
+    && indexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+    && indexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+}
+
+uint32_t RenderDevice::MaxBindlessTextures() const {
+  VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+  indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+  VkPhysicalDeviceProperties2 properties = {};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &indexingProperties;
+  vkGetPhysicalDeviceProperties2(_device, &properties);
+
+  // The array is in an update after bind pool, which has limits of its own
+  const VkPhysicalDeviceLimits& limits = _device_properties->limits;
+  return std::min({limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages, 
+    limits.maxDescriptorSetSamplers, limits.maxDescriptorSetSampledImages,
+    indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+    indexingProperties.maxDescriptorSetUpdateAfterBindSamplers, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages});
+}
+
+float RenderDevice::TimestampPeriod() const {
+  return _device_properties->limits.timestampPeriod;
+}
+
+uint32_t RenderDevice::TimestampValidBits(int queue) const {
+  if (queue < 0 || queue >= static_cast<int>(_queue_proprties.size())) return 0;
+  return _queue_proprties[queue].timestamp_valid_bits;
+}
+
+bool RenderDevice::SupportsExtension(const char* extension) const {
+  return std::any_of(_device_extensions.begin(), _device_extensions.end(), [extension](const VkExtensionProperties& e) {
+    return strcmp(e.extensionName, extension) == 0;
+  });
+}
+
 bool RenderDevice::SupportsRequiredExtensions(const std::vector<const char*>& required_extensions) const {
   for (const auto &re : required_extensions) {
     for (const auto &de : _device_extensions) {
@@ -130,6 +189,11 @@ const SwapChainProperties& RenderDevice::GetSwapChainProperties() const {
   return _swapchain_properties;
 }
 
+void RenderDevice::RefreshSurfaceCapabilities() {
+  auto surface = _parent->GetRenderer()->GetVKSurface();
+  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(_device, surface, &_swapchain_properties.capabilities);
+}
+
 const VkSurfaceFormatKHR& RenderDevice::GetPreferredSwapFormat(VkFormat format, VkColorSpaceKHR color_space) const {
   auto it = std::find_if(_swapchain_properties.formats.begin(), _swapchain_properties.formats.end(), [&format, &color_space](const VkSurfaceFormatKHR &p) {
     return (p.format == format && p.colorSpace == color_space);
@@ -152,6 +216,17 @@ const VkPresentModeKHR RenderDevice::GetPrefferedSwapMode(VkPresentModeKHR mode)
   }
 }
 
+const VkPresentModeKHR RenderDevice::GetPrefferedSwapMode(const std::vector<VkPresentModeKHR>& modes) const {
+  for (auto mode : modes) {
+    auto it = std::find(_swapchain_properties.present_modes.begin(), _swapchain_properties.present_modes.end(), mode);
+    if (it != _swapchain_properties.present_modes.end()) return *it;
+  }
+
+  // FIFO is the only mode every implementation has to support
+  std::cerr << "Requested present modes not supported" << std::endl; 
+  return VK_PRESENT_MODE_FIFO_KHR;
+}
+
 void RenderDevice::PrintSupportedOperations() const {
   std::cout << "[" << _device_name << "]" << std::endl << "\tDevice Queues: " <<  _queue_proprties.size() << std::endl;
   
@@ -479,6 +554,8 @@ bool RenderDeviceManager::InitDevices() {
 
   std::vector<VkPhysicalDevice> physicalDevices(deviceCount);
   vkEnumeratePhysicalDevices(_parent->GetVKInstance(), &deviceCount, physicalDevices.data());
+  // RenderDevice owns raw pointers, so it must never be moved by a reallocation
+  _devices.reserve(deviceCount);
   for (uint32_t i = 0; i < deviceCount; ++i) {
     _devices.emplace_back(physicalDevices[i], this);
   }
@@ -497,7 +574,10 @@ unsigned RenderDeviceManager::RateDevice(const RenderDevice& device) const {
   unsigned score = 0;
 
   // if device cant draw is useless
-  if (!device.SupportsOperation(VK_QUEUE_GRAPHICS_BIT) || device.GetPresentQueueIndex() == -1)
+  if (!device.SupportsOperation(VK_QUEUE_GRAPHICS_BIT))
+    return 0;
+
+  if (!_parent->Headless() && device.GetPresentQueueIndex() == -1)
     return 0;
 
   if (!device.SupportsRequiredExtensions(_parent->GetRequiredExtensions()))
@@ -517,7 +597,8 @@ RenderDevice* RenderDeviceManager::GuessBestDevice() {
   unsigned maxscore = 0;
   RenderDevice* bestDevice = nullptr;
   for (auto& device : _devices) {
-    if (unsigned currentscore = RateDevice(device) > maxscore) {
+    unsigned currentscore = RateDevice(device);
+    if (currentscore > maxscore) {
       maxscore = currentscore;
       bestDevice = &device;
     }
@@ -9,11 +9,12 @@ class Renderer;
 class RenderDeviceManager;
 
 struct QueueProperties {
-  QueueProperties(unsigned id, VkQueueFlags flags, bool presentation_support) :
-    id(id), flags(flags), presentation_support(presentation_support) {}
+  QueueProperties(unsigned id, VkQueueFlags flags, bool presentation_support, uint32_t timestamp_valid_bits) :
+    id(id), flags(flags), presentation_support(presentation_support), timestamp_valid_bits(timestamp_valid_bits) {}
   unsigned id;
   VkQueueFlags flags;
   bool presentation_support; 
+  uint32_t timestamp_valid_bits; // 0 if the queue can't write timestamps
 };
 
 struct SwapChainProperties {
@@ -34,10 +35,19 @@ public:
   int GetMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
   bool DiscreteGPU() const;
   unsigned MaxTextureSize() const;
+  // VK_EXT_descriptor_indexing with what a partially bound, non-uniformly indexed sampler array needs
+  bool SupportsBindlessTextures() const;
+  uint32_t MaxBindlessTextures() const;
+  float TimestampPeriod() const;
+  uint32_t TimestampValidBits(int queue) const;
+  bool SupportsExtension(const char* extension) const;
   bool SupportsRequiredExtensions(const std::vector<const char*>& required_extensions) const;
   const SwapChainProperties& GetSwapChainProperties() const;
+  void RefreshSurfaceCapabilities();
   const VkSurfaceFormatKHR& GetPreferredSwapFormat(VkFormat format, VkColorSpaceKHR color_space) const;
   const VkPresentModeKHR GetPrefferedSwapMode(VkPresentModeKHR mode) const;
+  // First supported mode in order of preference, FIFO if none are
+  const VkPresentModeKHR GetPrefferedSwapMode(const std::vector<VkPresentModeKHR>& modes) const;
   void PrintSupportedOperations() const;
 
 protected:
@@ -0,0 +1,493 @@
+#include "RenderGraph.hpp"
+#include "RenderDeviceManager.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+struct AccessInfo {
+  VkPipelineStageFlags stages;
+  VkAccessFlags access;
+  VkImageLayout layout; // images only
+  bool write;
+};
+
+// Only these need making available, read bits in a source access mask do nothing
+static const VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+static AccessInfo GetAccessInfo(Access access) {
+  switch (access) {
+    case Access::Acquired:
+      return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case Access::ColorAttachment:
+      return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true};
+    case Access::DepthAttachment:
+      return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true};
+    case Access::SampledFragment:
+      return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false};
+    case Access::SampledCompute:
+      return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false};
+    case Access::StorageRead:
+      return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false};
+    case Access::StorageWrite:
+      return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true};
+    case Access::TransferSrc:
+      return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false};
+    case Access::TransferDst:
+      return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true};
+    case Access::IndirectRead:
+      return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case Access::VertexRead:
+      return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case Access::Present:
+      return {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false};
+    case Access::None:
+    default:
+      return {VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, false};
+  }
+}
+
+static VkImageMemoryBarrier MakeImageBarrier(VkImage image, VkImageAspectFlags aspect, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+  VkImageLayout oldLayout, VkImageLayout newLayout) {
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = dstAccess;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = aspect;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+  return barrier;
+}
+
+bool TransientImageDesc::operator==(const TransientImageDesc& other) const {
+  return width == other.width && height == other.height && format == other.format && usage == other.usage && aspect == other.aspect;
+}
+
+RenderGraph::RenderGraph() {}
+
+RenderGraph::~RenderGraph() {
+  Destroy();
+}
+
+void RenderGraph::Init(VkDevice device, const RenderDevice* render_device) {
+  _device = device;
+  _render_device = render_device;
+}
+
+void RenderGraph::Destroy() {
+  DestroyTransients();
+  _passes.clear();
+  _resources.clear();
+  _device = VK_NULL_HANDLE;
+  _render_device = nullptr;
+}
+
+void RenderGraph::Reset() {
+  _passes.clear();
+  _resources.clear();
+}
+
+RenderResource RenderGraph::ImportImage(const char* name, VkImage image, VkImageAspectFlags aspect, Access initial, Access final) {
+  Resource resource = {};
+  resource.name = name;
+  resource.image = true;
+  resource.imported = true;
+  resource.vk_image = image;
+  resource.aspect = aspect;
+  resource.initial = initial;
+  resource.final = final;
+  _resources.push_back(resource);
+  return static_cast<RenderResource>(_resources.size() - 1);
+}
+
+RenderResource RenderGraph::ImportBuffer(const char* name, VkBuffer buffer) {
+  Resource resource = {};
+  resource.name = name;
+  resource.image = false;
+  resource.imported = true;
+  resource.vk_buffer = buffer;
+  _resources.push_back(resource);
+  return static_cast<RenderResource>(_resources.size() - 1);
+}
+
+RenderResource RenderGraph::CreateImage(const char* name, const TransientImageDesc& desc) {
+  Resource resource = {};
+  resource.name = name;
+  resource.image = true;
+  resource.imported = false;
+  resource.aspect = desc.aspect;
+  resource.desc = desc;
+  _resources.push_back(resource);
+  return static_cast<RenderResource>(_resources.size() - 1);
+}
+
+uint32_t RenderGraph::AddPass(const char* name, std::function<void(VkCommandBuffer)> record) {
+  Pass pass;
+  pass.name = name;
+  pass.record = std::move(record);
+  _passes.push_back(std::move(pass));
+  return static_cast<uint32_t>(_passes.size() - 1);
+}
+
+void RenderGraph::Read(uint32_t pass, RenderResource resource, Access access) {
+  _passes[pass].uses.push_back({resource, access, false});
+}
+
+void RenderGraph::Write(uint32_t pass, RenderResource resource, Access access) {
+  _passes[pass].uses.push_back({resource, access, true});
+}
+
+void RenderGraph::Cull() {
+  for (Resource& resource : _resources) resource.refs = 0;
+  for (Pass& pass : _passes) {
+    pass.refs = 0;
+    pass.culled = false;
+    for (const Use& use : pass.uses) {
+      if (use.write) pass.refs++;
+      else _resources[use.resource].refs++;
+    }
+  }
+
+  // Imported resources are read after the graph, so only transients nobody reads start the walk
+  std::vector<RenderResource> unread;
+  for (size_t i = 0; i < _resources.size(); i++) {
+    if (!_resources[i].imported && _resources[i].refs == 0) unread.push_back(static_cast<RenderResource>(i));
+  }
+
+  // Passes that declare no writes are kept, they're assumed to have effects the graph doesn't see
+  while (!unread.empty()) {
+    RenderResource resource = unread.back();
+    unread.pop_back();
+
+    for (Pass& pass : _passes) {
+      if (pass.culled) continue;
+      bool writes = std::any_of(pass.uses.begin(), pass.uses.end(), [&](const Use& use) { return use.write && use.resource == resource; });
+      if (!writes || --pass.refs > 0) continue;
+
+      pass.culled = true;
+      for (const Use& use : pass.uses) {
+        if (use.write) continue;
+        Resource& read = _resources[use.resource];
+        if (--read.refs == 0 && !read.imported) unread.push_back(use.resource);
+      }
+    }
+  }
+}
+
+bool RenderGraph::RealizeTransients() {
+  std::vector<Transient> wanted;
+  std::vector<RenderResource> owners;
+  for (size_t i = 0; i < _resources.size(); i++) {
+    const Resource& resource = _resources[i];
+    if (resource.imported || resource.first_pass == UINT32_MAX) continue;
+
+    Transient transient = {};
+    transient.desc = resource.desc;
+    transient.first_pass = resource.first_pass;
+    transient.last_pass = resource.last_pass;
+    wanted.push_back(transient);
+    owners.push_back(static_cast<RenderResource>(i));
+  }
+
+  bool same = wanted.size() == _transients.size() && std::equal(wanted.begin(), wanted.end(), _transients.begin(),
+    [](const Transient& a, const Transient& b) { return a.desc == b.desc && a.first_pass == b.first_pass && a.last_pass == b.last_pass; });
+
+  if (!same) {
+    DestroyTransients();
+    if (!wanted.empty() && (_device == VK_NULL_HANDLE || _render_device == nullptr)) {
+      std::cerr << "Failed to create transient images, the render graph wasn't initialized" << std::endl;
+      return false;
+    }
+
+    _transients = wanted;
+    for (Transient& transient : _transients) {
+      VkImageCreateInfo imageInfo = {};
+      imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+      imageInfo.imageType = VK_IMAGE_TYPE_2D;
+      imageInfo.extent = {transient.desc.width, transient.desc.height, 1};
+      imageInfo.mipLevels = 1;
+      imageInfo.arrayLayers = 1;
+      imageInfo.format = transient.desc.format;
+      imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+      imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      imageInfo.usage = transient.desc.usage;
+      imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+      imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+      if (vkCreateImage(_device, &imageInfo, nullptr, &transient.image) != VK_SUCCESS) {
+        std::cerr << "Failed to create transient image" << std::endl;
+        DestroyTransients();
+        return false;
+      }
+    }
+
+    // Greedy in order of first use: an image takes the memory of one that is done before it starts,
+    // growing it if needed, or gets a block of its own
+    struct Block {
+      VkDeviceSize size;
+      uint32_t memory_types;
+      uint32_t last_pass;
+    };
+    std::vector<Block> blocks;
+    std::vector<size_t> order(_transients.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return _transients[a].first_pass < _transients[b].first_pass; });
+
+    for (size_t i : order) {
+      Transient& transient = _transients[i];
+      VkMemoryRequirements requirements;
+      vkGetImageMemoryRequirements(_device, transient.image, &requirements);
+
+      size_t best = blocks.size();
+      for (size_t b = 0; b < blocks.size(); b++) {
+        if (blocks[b].last_pass >= transient.first_pass || (blocks[b].memory_types & requirements.memoryTypeBits) == 0) continue;
+        if (best == blocks.size() || blocks[b].size > blocks[best].size) best = b;
+      }
+
+      if (best == blocks.size()) {
+        blocks.push_back({requirements.size, requirements.memoryTypeBits, transient.last_pass});
+      } else {
+        blocks[best].size = std::max(blocks[best].size, requirements.size);
+        blocks[best].memory_types &= requirements.memoryTypeBits;
+        blocks[best].last_pass = transient.last_pass;
+      }
+      transient.block = static_cast<uint32_t>(best);
+    }
+
+    for (const Block& block : blocks) {
+      int memoryType = _render_device->GetMemoryTypeIndex(block.memory_types, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      VkDeviceMemory memory = VK_NULL_HANDLE;
+
+      VkMemoryAllocateInfo allocInfo = {};
+      allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      allocInfo.allocationSize = block.size;
+      allocInfo.memoryTypeIndex = static_cast<uint32_t>(memoryType);
+
+      if (memoryType < 0 || vkAllocateMemory(_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        std::cerr << "Failed to allocate transient image memory" << std::endl;
+        DestroyTransients();
+        return false;
+      }
+      _blocks.push_back(memory);
+    }
+
+    for (Transient& transient : _transients) {
+      vkBindImageMemory(_device, transient.image, _blocks[transient.block], 0);
+
+      VkImageViewCreateInfo viewInfo = {};
+      viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      viewInfo.image = transient.image;
+      viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      viewInfo.format = transient.desc.format;
+      viewInfo.subresourceRange.aspectMask = transient.desc.aspect;
+      viewInfo.subresourceRange.baseMipLevel = 0;
+      viewInfo.subresourceRange.levelCount = 1;
+      viewInfo.subresourceRange.baseArrayLayer = 0;
+      viewInfo.subresourceRange.layerCount = 1;
+
+      if (vkCreateImageView(_device, &viewInfo, nullptr, &transient.view) != VK_SUCCESS) {
+        std::cerr << "Failed to create transient image view" << std::endl;
+        DestroyTransients();
+        return false;
+      }
+    }
+  }
+
+  // Whoever used a block last before each image, so its first barrier waits for that use
+  std::vector<int32_t> previous(_blocks.size(), -1);
+  std::vector<size_t> order(_transients.size());
+  for (size_t i = 0; i < order.size(); i++) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return _transients[a].first_pass < _transients[b].first_pass; });
+
+  for (size_t i : order) {
+    Resource& resource = _resources[owners[i]];
+    resource.transient = static_cast<uint32_t>(i);
+    resource.vk_image = _transients[i].image;
+    resource.vk_image_view = _transients[i].view;
+    resource.aliases = previous[_transients[i].block];
+    previous[_transients[i].block] = static_cast<int32_t>(owners[i]);
+  }
+
+  return true;
+}
+
+void RenderGraph::DestroyTransients() {
+  if (_device == VK_NULL_HANDLE) return;
+
+  for (Transient& transient : _transients) {
+    vkDestroyImageView(_device, transient.view, nullptr);
+    vkDestroyImage(_device, transient.image, nullptr);
+  }
+  for (VkDeviceMemory memory : _blocks) {
+    vkFreeMemory(_device, memory, nullptr);
+  }
+
+  _transients.clear();
+  _blocks.clear();
+}
+
+void RenderGraph::AddBarrier(Pass& pass, Resource& resource, State& state, Access access, bool write) {
+  AccessInfo info = GetAccessInfo(access);
+  bool transition = resource.image && info.layout != state.layout;
+  // Writes wait for everything before them, reads only for a write they can't see yet
+  bool hazard = write ? (state.write_stages | state.read_stages) != 0
+    : state.write_stages != 0 && (info.stages & ~state.visible_stages) != 0;
+
+  if (transition || hazard) {
+    VkPipelineStageFlags srcStages = (write || transition) ? (state.write_stages | state.read_stages) : state.write_stages;
+    VkAccessFlags srcAccess = state.write_access & WRITE_ACCESS;
+
+    if (resource.image) {
+      pass.image_barriers.push_back(MakeImageBarrier(resource.vk_image, resource.aspect, srcAccess, info.access, state.layout,
+        transition ? info.layout : state.layout));
+    } else {
+      pass.memory_barrier.srcAccessMask |= srcAccess;
+      pass.memory_barrier.dstAccessMask |= info.access;
+    }
+
+    if (srcStages == 0) srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    pass.src_stages |= srcStages;
+    pass.dst_stages |= info.stages;
+  }
+
+  if (write) {
+    state.write_stages = info.stages;
+    state.write_access = info.access;
+    state.read_stages = 0;
+    state.visible_stages = 0;
+  } else if (transition) {
+    // The transition itself is a write the later readers have to wait for
+    state.write_stages = info.stages;
+    state.write_access = 0;
+    state.read_stages = info.stages;
+    state.visible_stages = info.stages;
+  } else {
+    state.read_stages |= info.stages;
+    if (hazard) state.visible_stages |= info.stages;
+  }
+
+  if (resource.image) state.layout = info.layout;
+}
+
+bool RenderGraph::Compile() {
+  Cull();
+
+  for (Resource& resource : _resources) {
+    resource.first_pass = UINT32_MAX;
+    resource.last_pass = 0;
+    resource.aliases = -1;
+  }
+
+  for (uint32_t i = 0; i < _passes.size(); i++) {
+    if (_passes[i].culled) continue;
+    for (const Use& use : _passes[i].uses) {
+      Resource& resource = _resources[use.resource];
+      resource.first_pass = std::min(resource.first_pass, i);
+      resource.last_pass = std::max(resource.last_pass, i);
+    }
+  }
+
+  if (!RealizeTransients()) return false;
+
+  // Imported resources were last touched before the submit, the semaphore or fence covers the memory
+  // side so only the stages are kept to chain onto
+  std::vector<State> states(_resources.size());
+  for (size_t i = 0; i < _resources.size(); i++) {
+    if (!_resources[i].imported) continue;
+    AccessInfo info = GetAccessInfo(_resources[i].initial);
+    if (_resources[i].initial != Access::None) states[i].read_stages = info.stages;
+    states[i].layout = _resources[i].image ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+  }
+
+  for (uint32_t i = 0; i < _passes.size(); i++) {
+    Pass& pass = _passes[i];
+    pass.src_stages = 0;
+    pass.dst_stages = 0;
+    pass.memory_barrier = {};
+    pass.memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    pass.image_barriers.clear();
+    if (pass.culled) continue;
+
+    for (const Use& use : pass.uses) {
+      Resource& resource = _resources[use.resource];
+      State& state = states[use.resource];
+
+      // An aliased image starts where the previous owner of its memory left off, minus the contents
+      if (resource.first_pass == i && resource.aliases >= 0) {
+        state = states[resource.aliases];
+        state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+      }
+
+      AddBarrier(pass, resource, state, use.access, use.write);
+    }
+  }
+
+  _final.src_stages = 0;
+  _final.dst_stages = 0;
+  _final.memory_barrier = {};
+  _final.memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  _final.image_barriers.clear();
+
+  for (size_t i = 0; i < _resources.size(); i++) {
+    Resource& resource = _resources[i];
+    if (resource.imported && resource.image && resource.final != Access::None)
+      AddBarrier(_final, resource, states[i], resource.final, false);
+  }
+
+  return true;
+}
+
+void RenderGraph::RecordBarriers(VkCommandBuffer command_buffer, const Pass& pass) const {
+  if (pass.src_stages == 0) return;
+
+  // Execution only dependencies still need the call, just without a memory barrier
+  bool memory = pass.memory_barrier.srcAccessMask != 0 || pass.memory_barrier.dstAccessMask != 0;
+  vkCmdPipelineBarrier(command_buffer, pass.src_stages, pass.dst_stages, 0,
+    memory ? 1 : 0, memory ? &pass.memory_barrier : nullptr, 0, nullptr,
+    static_cast<uint32_t>(pass.image_barriers.size()), pass.image_barriers.data());
+}
+
+void RenderGraph::Execute(VkCommandBuffer command_buffer) {
+  for (const Pass& pass : _passes) {
+    if (pass.culled) continue;
+    RecordBarriers(command_buffer, pass);
+    pass.record(command_buffer);
+  }
+
+  RecordBarriers(command_buffer, _final);
+}
+
+VkImage RenderGraph::GetImage(RenderResource resource) const {
+  return _resources[resource].vk_image;
+}
+
+VkImageView RenderGraph::GetImageView(RenderResource resource) const {
+  return _resources[resource].vk_image_view;
+}
+
+VkBuffer RenderGraph::GetBuffer(RenderResource resource) const {
+  return _resources[resource].vk_buffer;
+}
+
+bool RenderGraph::Culled(uint32_t pass) const {
+  return _passes[pass].culled;
+}
+
+void RenderGraph::RecordTransition(VkCommandBuffer command_buffer, VkImage image, VkImageAspectFlags aspect, Access from, Access to) {
+  AccessInfo src = GetAccessInfo(from);
+  AccessInfo dst = GetAccessInfo(to);
+
+  VkImageMemoryBarrier barrier = MakeImageBarrier(image, aspect, src.access & WRITE_ACCESS, dst.access, src.layout, dst.layout);
+  vkCmdPipelineBarrier(command_buffer, src.stages, dst.stages, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
@@ -0,0 +1,163 @@
+#ifndef RENDER_GRAPH_HPP
+#define RENDER_GRAPH_HPP
+
+#include "VulkanHeaders.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class RenderDevice;
+
+// How a pass touches a resource. Each one implies the pipeline stages, access mask and, for images, the
+// layout, so passes never spell out barriers themselves.
+enum class Access : uint8_t {
+  None,            // nothing before, the contents are undefined
+  Acquired,        // swapchain image, the submit waits on the acquire semaphore at color attachment output
+  ColorAttachment,
+  DepthAttachment,
+  SampledFragment,
+  SampledCompute,
+  StorageRead,     // compute
+  StorageWrite,    // compute, may read too
+  TransferSrc,
+  TransferDst,
+  IndirectRead,
+  VertexRead,
+  Present
+};
+
+struct TransientImageDesc {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  VkImageUsageFlags usage = 0;
+  VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+  bool operator==(const TransientImageDesc& other) const;
+};
+
+using RenderResource = uint32_t;
+
+// Frame graph rebuilt every frame. Passes declare what they read and write, Compile orders nothing
+// (passes run in the order they were added) but works out the rest:
+//  - passes whose writes nobody reads are culled, writes to imported resources always count as read
+//  - one vkCmdPipelineBarrier before each pass with the layout transitions and the memory and execution
+//    dependencies its accesses need, nothing for read after read in the same layout
+//  - transient images whose lifetimes don't overlap share memory
+//  - imported images end in their final access after the last pass
+//
+// Transient images stay alive between frames and are only recreated when the set of them or their
+// lifetimes change, so the graph has to outlive the command buffers it records into. Keep one per frame
+// in flight.
+class RenderGraph {
+public:
+  RenderGraph();
+  ~RenderGraph();
+  RenderGraph(const RenderGraph&) = delete;
+  RenderGraph& operator=(const RenderGraph&) = delete;
+
+  // Only needed by graphs with transient images
+  void Init(VkDevice device, const RenderDevice* render_device);
+  void Destroy();
+
+  // Forgets the passes and resources of the last frame, keeps the transient images
+  void Reset();
+  RenderResource ImportImage(const char* name, VkImage image, VkImageAspectFlags aspect, Access initial, Access final);
+  RenderResource ImportBuffer(const char* name, VkBuffer buffer);
+  RenderResource CreateImage(const char* name, const TransientImageDesc& desc);
+
+  uint32_t AddPass(const char* name, std::function<void(VkCommandBuffer)> record);
+  // One access per resource per pass, Write for anything that both reads and writes
+  void Read(uint32_t pass, RenderResource resource, Access access);
+  void Write(uint32_t pass, RenderResource resource, Access access);
+
+  // False if transient images couldn't be created
+  bool Compile();
+  void Execute(VkCommandBuffer command_buffer);
+
+  // Valid after Compile, transients are VK_NULL_HANDLE when every pass using them was culled
+  VkImage GetImage(RenderResource resource) const;
+  VkImageView GetImageView(RenderResource resource) const;
+  VkBuffer GetBuffer(RenderResource resource) const;
+  bool Culled(uint32_t pass) const;
+
+  // A single layout transition outside of any graph, e.g. for uploads
+  static void RecordTransition(VkCommandBuffer command_buffer, VkImage image, VkImageAspectFlags aspect, Access from, Access to);
+
+protected:
+  struct Use {
+    RenderResource resource;
+    Access access;
+    bool write;
+  };
+
+  struct Pass {
+    const char* name;
+    std::function<void(VkCommandBuffer)> record;
+    std::vector<Use> uses;
+    uint32_t refs = 0;
+    bool culled = false;
+    // Filled by Compile, recorded before the pass
+    VkPipelineStageFlags src_stages = 0;
+    VkPipelineStageFlags dst_stages = 0;
+    VkMemoryBarrier memory_barrier = {};
+    std::vector<VkImageMemoryBarrier> image_barriers;
+  };
+
+  struct Resource {
+    const char* name;
+    bool image;
+    bool imported;
+    VkImage vk_image = VK_NULL_HANDLE;
+    VkImageView vk_image_view = VK_NULL_HANDLE;
+    VkBuffer vk_buffer = VK_NULL_HANDLE;
+    VkImageAspectFlags aspect = 0;
+    Access initial = Access::None;
+    Access final = Access::None;
+    TransientImageDesc desc;
+    uint32_t refs = 0;
+    // Live passes, UINT32_MAX when unused
+    uint32_t first_pass = UINT32_MAX;
+    uint32_t last_pass = 0;
+    uint32_t transient = UINT32_MAX; // index into _transients
+    int32_t aliases = -1;            // resource that had the memory before this one
+  };
+
+  // Everything a barrier needs to know about what happened to a resource so far
+  struct State {
+    VkPipelineStageFlags write_stages = 0;
+    VkAccessFlags write_access = 0;
+    VkPipelineStageFlags read_stages = 0;   // since the last write
+    VkPipelineStageFlags visible_stages = 0; // the last write is visible to these
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  };
+
+  // A transient image as it was last created, reused while the next frame asks for the same
+  struct Transient {
+    TransientImageDesc desc;
+    uint32_t first_pass;
+    uint32_t last_pass;
+    uint32_t block;
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+  };
+
+  void Cull();
+  bool RealizeTransients();
+  void DestroyTransients();
+  void AddBarrier(Pass& pass, Resource& resource, State& state, Access access, bool write);
+  void RecordBarriers(VkCommandBuffer command_buffer, const Pass& pass) const;
+
+  VkDevice _device = VK_NULL_HANDLE;
+  const RenderDevice* _render_device = nullptr;
+
+  std::vector<Pass> _passes;
+  std::vector<Resource> _resources;
+  Pass _final; // transitions of imported images to their final access
+
+  std::vector<Transient> _transients;
+  std::vector<VkDeviceMemory> _blocks;
+};
+
+#endif
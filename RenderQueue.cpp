@@ -0,0 +1,150 @@
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+
+// Below this the sort finishes before the workers would have woken up
+static const size_t PARALLEL_SORT_THRESHOLD = 16384;
+static const size_t MIN_PACKETS_PER_JOB = 8192;
+
+static const unsigned LAYER_SHIFT = 48;
+static const unsigned PIPELINE_SHIFT = 40;
+static const unsigned TEXTURE_SHIFT = 24;
+
+uint64_t RenderQueue::MakeKey(uint32_t layer, uint32_t pipeline, uint32_t texture, uint32_t order) {
+  return (static_cast<uint64_t>(layer & 0xFFFF) << LAYER_SHIFT)
+    | (static_cast<uint64_t>(pipeline & 0xFF) << PIPELINE_SHIFT)
+    | (static_cast<uint64_t>(texture & 0xFFFF) << TEXTURE_SHIFT)
+    | (order & 0xFFFFFF);
+}
+
+uint32_t RenderQueue::KeyLayer(uint64_t key) {
+  return static_cast<uint32_t>(key >> LAYER_SHIFT) & 0xFFFF;
+}
+
+uint32_t RenderQueue::KeyPipeline(uint64_t key) {
+  return static_cast<uint32_t>(key >> PIPELINE_SHIFT) & 0xFF;
+}
+
+uint32_t RenderQueue::KeyTexture(uint64_t key) {
+  return static_cast<uint32_t>(key >> TEXTURE_SHIFT) & 0xFFFF;
+}
+
+void RenderQueue::Clear() {
+  _packets.clear();
+  _batches.clear();
+}
+
+void RenderQueue::Reserve(size_t count) {
+  _packets.reserve(count);
+  _scratch.reserve(count);
+}
+
+void RenderQueue::Push(uint64_t key, uint32_t index) {
+  _packets.push_back({key, index});
+}
+
+const std::vector<DrawPacket>& RenderQueue::Packets() const {
+  return _packets;
+}
+
+void RenderQueue::Sort(WorkerPool* workers) {
+  size_t count = _packets.size();
+  if (count < 2) return;
+
+  unsigned jobCount = 1;
+  if (workers != nullptr && count >= PARALLEL_SORT_THRESHOLD)
+    jobCount = static_cast<unsigned>(std::clamp<size_t>(count / MIN_PACKETS_PER_JOB, 1, workers->Concurrency()));
+  size_t perJob = (count + jobCount - 1) / jobCount;
+
+  auto dispatch = [&](const std::function<void(unsigned)>& job) {
+    if (jobCount > 1) workers->Dispatch(jobCount, job);
+    else job(0);
+  };
+
+  // Bits that differ anywhere in the queue, bytes outside of it don't need a pass
+  std::vector<uint64_t> jobBits(jobCount * 2);
+  dispatch([&](unsigned job) {
+    size_t first = job * perJob, last = std::min(first + perJob, count);
+    uint64_t ones = 0, zeros = 0;
+    for (size_t i = first; i < last; ++i) {
+      ones |= _packets[i].key;
+      zeros |= ~_packets[i].key;
+    }
+    jobBits[job * 2] = ones;
+    jobBits[job * 2 + 1] = zeros;
+  });
+
+  uint64_t ones = 0, zeros = 0;
+  for (unsigned job = 0; job < jobCount; ++job) {
+    ones |= jobBits[job * 2];
+    zeros |= jobBits[job * 2 + 1];
+  }
+  uint64_t varying = ones & zeros;
+
+  _scratch.resize(count);
+  DrawPacket* src = _packets.data();
+  DrawPacket* dst = _scratch.data();
+
+  for (unsigned pass = 0; pass < PASSES; ++pass) {
+    unsigned shift = pass * 8;
+    if (((varying >> shift) & 0xFF) == 0) continue;
+
+    _counts.assign(jobCount * RADIX, 0);
+
+    dispatch([&](unsigned job) {
+      size_t first = job * perJob, last = std::min(first + perJob, count);
+      size_t* counts = &_counts[job * RADIX];
+      for (size_t i = first; i < last; ++i) {
+        counts[(src[i].key >> shift) & 0xFF]++;
+      }
+    });
+
+    // Turn the counts into where each job starts writing each digit. Lower jobs go first within a
+    // digit, which is what keeps the sort stable.
+    size_t offset = 0;
+    for (unsigned digit = 0; digit < RADIX; ++digit) {
+      for (unsigned job = 0; job < jobCount; ++job) {
+        size_t digitCount = _counts[job * RADIX + digit];
+        _counts[job * RADIX + digit] = offset;
+        offset += digitCount;
+      }
+    }
+
+    dispatch([&](unsigned job) {
+      size_t first = job * perJob, last = std::min(first + perJob, count);
+      size_t* offsets = &_counts[job * RADIX];
+      for (size_t i = first; i < last; ++i) {
+        dst[offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
+      }
+    });
+
+    std::swap(src, dst);
+  }
+
+  if (src != _packets.data())
+    _packets.swap(_scratch);
+}
+
+const std::vector<DrawBatch>& RenderQueue::BuildBatches(bool split_layers) {
+  _batches.clear();
+
+  for (size_t i = 0; i < _packets.size(); ++i) {
+    uint32_t pipeline = KeyPipeline(_packets[i].key);
+    uint32_t texture = KeyTexture(_packets[i].key);
+    uint32_t layer = KeyLayer(_packets[i].key);
+
+    // Layers usually only order the packets, then a change of layer doesn't need a new draw
+    if (!_batches.empty() && _batches.back().pipeline == pipeline && _batches.back().texture == texture
+      && (!split_layers || _batches.back().layer == layer)) {
+      _batches.back().count++;
+    } else {
+      _batches.push_back({pipeline, texture, static_cast<uint32_t>(i), 1, layer});
+    }
+  }
+
+  return _batches;
+}
+
+const std::vector<DrawBatch>& RenderQueue::Batches() const {
+  return _batches;
+}
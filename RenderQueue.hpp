@@ -0,0 +1,60 @@
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+
+#include "WorkerPool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One quad to draw, index points back into whatever list the packets were built from
+struct DrawPacket {
+  uint64_t key;
+  uint32_t index;
+};
+
+// A run of sorted packets that can go out as a single draw
+struct DrawBatch {
+  uint32_t pipeline;
+  uint32_t texture;
+  uint32_t first;
+  uint32_t count;
+  uint32_t layer; // of the first packet, the only one unless batches are split by layer
+};
+
+// Collects draw packets and orders them by layer, then pipeline, then texture, so state only
+// changes between runs. The sort is stable, packets with the same key keep their submission order,
+// which is what keeps overlapping sprites in one layer drawn the way the game listed them.
+//
+// Key layout, most significant first:
+//   63..48 layer | 47..40 pipeline | 39..24 texture | 23..0 free for ordering within a run
+class RenderQueue {
+public:
+  static uint64_t MakeKey(uint32_t layer, uint32_t pipeline, uint32_t texture, uint32_t order = 0);
+  static uint32_t KeyLayer(uint64_t key);
+  static uint32_t KeyPipeline(uint64_t key);
+  static uint32_t KeyTexture(uint64_t key);
+
+  void Clear();
+  void Reserve(size_t count);
+  void Push(uint64_t key, uint32_t index);
+  // LSD radix sort over bytes, bytes every key shares are skipped. Above a few thousand packets the
+  // counting and scattering are split across the pool.
+  void Sort(WorkerPool* workers = nullptr);
+  const std::vector<DrawPacket>& Packets() const;
+  // Merges consecutive packets with the same pipeline and texture, call after Sort. split_layers also
+  // starts a new batch whenever the layer changes, for when the layer is more than an order.
+  const std::vector<DrawBatch>& BuildBatches(bool split_layers = false);
+  const std::vector<DrawBatch>& Batches() const;
+
+protected:
+  static const unsigned RADIX = 256;
+  static const unsigned PASSES = 8;
+
+  std::vector<DrawPacket> _packets;
+  std::vector<DrawPacket> _scratch;
+  std::vector<DrawBatch> _batches;
+  std::vector<size_t> _counts; // per job, per digit
+};
+
+#endif
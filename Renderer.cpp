@@ -1,21 +1,102 @@
 #include "Renderer.hpp"
 #include "Resource.hpp"
+#include "ShaderTables.hpp"
+#include "Tick.hpp"
 #include "Vertex.hpp"
 
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 #include <cstring>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
 
-static const int MAX_FRAMES_IN_FLIGHT = 2;
+static double ElapsedMs(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+// Zones are a handful of passes per frame, this is plenty
+static const uint32_t MAX_GPU_ZONES = 16;
+// Only used with VK_EXT_calibrated_timestamps, the fallback stalls the queue so it only runs once
+static const int64_t GPU_CALIBRATION_INTERVAL_NS = 1000000000;
+// Below this many sprites per job it's cheaper to write vertices on one thread than to wake the pool
+static const size_t MIN_SPRITES_PER_JOB = 2048;
+// Sorted sprites merge into a handful of draws, secondary buffers only pay off with a lot of state changes
+static const size_t MIN_BATCHES_PER_JOB = 256;
+static const size_t MIN_SPRITE_CAPACITY = 1024;
+// Quads in the shared index buffer. 65536 vertices is all a UINT16 index reaches, longer runs are split
+// into several draws that each start at index 0 with a vertexOffset.
+static const uint32_t MAX_QUADS_PER_DRAW = 16384;
+// Matches local_size_x in shaders/cull.comp
+static const uint32_t CULL_GROUP_SIZE = 256;
+// Texture ids are 16 bits in packed vertices and sort keys
+static const uint32_t MAX_TEXTURES = 1 << 16;
+// Size of the bindless descriptor array, the device limit can be far larger than we need
+static const uint32_t MAX_BINDLESS_TEXTURES = 1024;
+// Texture slots the first descriptor pool has sets for without bindless textures
+static const size_t MIN_TEXTURE_SLOTS = 16;
+// Loads mostly wait on the disk, a couple of threads keep it busy without competing with the workers
+static const unsigned ASSET_LOADER_THREADS = 2;
+// Written by the ResourcePacker target, next to the executable's working directory like Atlas.png
+static const char* ASSET_ARCHIVE = "Assets.pak";
+// Pipeline cache carried over between runs, so pipelines after the first run come mostly from disk
+static const char* PIPELINE_CACHE = "Pipelines.cache";
+// With depth layering the top bit of a sort key's layer marks translucent sprites, the rest is the layer
+static const uint32_t DEPTH_LAYERS = 1 << 15;
+static const uint32_t DEPTH_TRANSLUCENT = 1 << 15;
+// Every device supports it as a depth attachment and it still has two values per layer
+static const VkFormat DEPTH_FORMAT = VK_FORMAT_D16_UNORM;
+
+struct LatencyPolicy {
+  size_t frames_in_flight;
+  uint32_t extra_images; // on top of the surface's minImageCount
+  std::vector<VkPresentModeKHR> present_modes;
+};
+
+static size_t VertexSize(VertexFormat format) {
+  return (format == VertexFormat::Packed) ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+// Opaque sprites sort first and nearest first so the depth test rejects what they cover, translucent
+// ones after them from back to front
+static uint32_t DepthSortLayer(uint32_t layer, bool opaque) {
+  layer = std::min(layer, DEPTH_LAYERS - 1);
+  return opaque ? (DEPTH_LAYERS - 1 - layer) : (DEPTH_TRANSLUCENT | layer);
+}
+
+// Higher layers are nearer, 1 is left to the clear
+static float LayerDepth(uint32_t sortLayer) {
+  uint32_t layer = (sortLayer & DEPTH_TRANSLUCENT) ? (sortLayer & ~DEPTH_TRANSLUCENT) : (DEPTH_LAYERS - 1 - sortLayer);
+  return 1.0f - static_cast<float>(layer + 1) / static_cast<float>(DEPTH_LAYERS + 1);
+}
+
+static LatencyPolicy GetLatencyPolicy(LatencyMode mode) {
+  switch (mode) {
+    // The CPU never runs ahead of the GPU and presents replace queued images instead of waiting behind them
+    case LatencyMode::LowLatency: return {1, 1, {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR}};
+    // Extra image and frame so neither the CPU nor the GPU waits on the other
+    case LatencyMode::Throughput: return {3, 2, {VK_PRESENT_MODE_MAILBOX_KHR}};
+    case LatencyMode::VSync:
+    default: return {2, 1, {VK_PRESENT_MODE_FIFO_KHR}};
+  }
+}
 
 struct UniformBufferObject {
   glm::mat4 view;
   glm::mat4 proj;
 };
 
+struct CullConstants {
+  glm::vec4 view; // min in xy, max in zw
+  uint32_t count;
+};
+
+static_assert(sizeof(CullConstants) == shader_tables::cull_comp.push_constant_size, "CullConstants doesn't match cull.comp");
+static_assert(sizeof(glm::vec2) == shader_tables::sprite_packed_vert.push_constant_size, "The origin doesn't match sprite.vert");
+
 const std::vector<Vertex> vertices = {
   {{0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 0.0f}},
   {{1280.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
@@ -23,6 +104,7 @@ const std::vector<Vertex> vertices = {
   {{0.0f, 720.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f}}
 };
 
+// Index pattern of one quad, repeated MAX_QUADS_PER_DRAW times in _vk_index_buffer
 const std::vector<uint16_t> indices = {
   0, 1, 2, 2, 3, 0
 };
@@ -53,34 +135,44 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(VkDebugUtilsMessageSeverityF
   return VK_FALSE;
 }
 
-Renderer::Renderer() : _device_manager(this) {
+Renderer::Renderer() : _device_manager(this), _workers(std::max(1u, std::thread::hardware_concurrency()) - 1), 
+  _asset_loader(ASSET_LOADER_THREADS) {
 }
 
 Renderer::~Renderer() {
 
   vkDeviceWaitIdle(_vk_logical_device);
 
+  _pipelines.Destroy();
   DestroySwapChain();
 
   vkDestroySampler(_vk_logical_device, _vk_texture_sampler, nullptr);
-  vkDestroyImageView(_vk_logical_device, _vk_texture_image_view, nullptr);
 
-  vkDestroyImage(_vk_logical_device, _vk_texture_image, nullptr);
-  vkFreeMemory(_vk_logical_device, _vk_texture_image_memory, nullptr);
+  for (Texture& texture : _textures)
+    DestroyTexture(texture);
 
   vkDestroyDescriptorSetLayout(_vk_logical_device, _vk_descriptor_set_layout, nullptr);
 
+  vkDestroyPipeline(_vk_logical_device, _vk_cull_pipeline, nullptr);
+  vkDestroyPipelineLayout(_vk_logical_device, _vk_cull_pipeline_layout, nullptr);
+  vkDestroyDescriptorSetLayout(_vk_logical_device, _vk_cull_descriptor_set_layout, nullptr);
+
+  vkDestroyBuffer(_vk_logical_device, _gpu_sprite_buffer, nullptr);
+  vkFreeMemory(_vk_logical_device, _gpu_sprite_buffer_memory, nullptr);
+
   vkDestroyBuffer(_vk_logical_device, _vk_index_buffer, nullptr);
   vkFreeMemory(_vk_logical_device, _vk_index_buffer_memory, nullptr);
 
+  for (auto& chunk : _chunk_buffers) {
+    vkDestroyBuffer(_vk_logical_device, chunk.vertex_buffer, nullptr);
+    vkFreeMemory(_vk_logical_device, chunk.vertex_buffer_memory, nullptr);
+  }
+
   vkDestroyBuffer(_vk_logical_device, _vk_vertex_buffer, nullptr);
   vkFreeMemory(_vk_logical_device, _vk_vertex_buffer_memory, nullptr);
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-    vkDestroySemaphore(_vk_logical_device, _vk_render_finished_semaphores[i], nullptr);
-    vkDestroySemaphore(_vk_logical_device, _vk_image_available_semaphores[i], nullptr);
-    vkDestroyFence(_vk_logical_device, _vk_in_flight_fences[i], nullptr);
-  }
+  DestroySyncObjects();
+  DestroyCommandBuffers();
 
   vkDestroyCommandPool(_vk_logical_device, _vk_command_pool, nullptr);
 
@@ -97,6 +189,29 @@ Renderer::~Renderer() {
 bool Renderer::Init(GLFWwindow* window, const char* game_name, const char* engine_name, const std::vector<const char*>& extensions) {
   _window = window;
 
+  int width = 0, height = 0;
+  glfwGetFramebufferSize(_window, &width, &height);
+  _framebuffer_width = width;
+  _framebuffer_height = height;
+
+  return InitRenderer(game_name, engine_name, extensions);
+}
+
+bool Renderer::InitHeadless(uint32_t width, uint32_t height, const char* game_name, const char* engine_name, 
+  const std::vector<const char*>& extensions) {
+  _window = nullptr;
+  _headless = true;
+  _vk_swapchain_extent = {width, height};
+
+  return InitRenderer(game_name, engine_name, extensions);
+}
+
+bool Renderer::InitRenderer(const char* game_name, const char* engine_name, const std::vector<const char*>& extensions) {
+  // Packed builds ship their art in one mapped archive, loose files are used for anything it doesn't have
+  _asset_loader.Mount(ASSET_ARCHIVE);
+  // Reading and decoding the atlas overlaps everything up to InitTextureImage
+  _atlas = _asset_loader.LoadImage("Atlas.png");
+
   if (
        (!InitInstance(game_name, engine_name, extensions))
     || (!InitSurface())
@@ -106,11 +221,13 @@ bool Renderer::Init(GLFWwindow* window, const char* game_name, const char* engin
     || (!InitImageViews())
     || (!InitRenderPass())
     || (!InitDescriptorSetLayout())
+    || (!_pipelines.Init(_vk_logical_device, PIPELINE_CACHE))
     || (!InitGraphicsPipeline())
+    || (!InitCullPipeline())
     || (!InitFramebuffers())
     || (!InitCommandPool())
     || (!InitTextureImage())
-    || (!InitTextureImageView())
+    || (!_texture_manager.Init())
     || (!InitTextureSampler())
     || (!InitVertexBuffer())
     || (!InitIndexBuffer())
@@ -119,6 +236,7 @@ bool Renderer::Init(GLFWwindow* window, const char* game_name, const char* engin
     || (!InitDescriptorSets())
     || (!InitCommandBuffers())
     || (!InitSyncObjects())
+    || (!WaitForPipelines())
    ) {
 
     std::cerr << "Failed to initialize vulkan" << std::endl;
@@ -131,6 +249,10 @@ bool Renderer::DebugEnabled() {
   return _enable_validation_layers;
 }
 
+bool Renderer::Headless() const {
+  return _headless;
+}
+
 bool Renderer::InitInstance(const char* game_name, const char* engine_name, const std::vector<const char*>& extensions) {
   VkApplicationInfo appInfo = {};
   appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -218,22 +340,36 @@ VkSurfaceKHR Renderer::GetVKSurface() {
 bool Renderer::InitLogicalDevice() {
 
   int graphicsQueueID = _device_manager.GetOperationQueueIndex(VK_QUEUE_GRAPHICS_BIT);
-  int presentsQueueID = _device_manager.GetPresentQueueIndex();
+  // Nothing is ever presented without a surface
+  int presentsQueueID = (_headless) ? graphicsQueueID : _device_manager.GetPresentQueueIndex();
 
   if (graphicsQueueID == -1 || presentsQueueID == -1) {
     std::cerr << "Failed to find suitable graphics queue(s)" << std::endl;
     return false;
   } 
-  
-  // If graphics queues are seperate we need two devices
-  unsigned queueCount = (graphicsQueueID != presentsQueueID) + 1;
-  std::vector<VkDeviceQueueCreateInfo> queueCreateInfos(queueCount);
+
+  // GPU sprite culling runs on the first compute capable family, which is usually the graphics one
+  RenderDevice* device = _device_manager.GetCurrentDevice();
+  _compute_queue_family = -1;
+  if (device->SupportsOperation(VK_QUEUE_COMPUTE_BIT))
+    _compute_queue_family = device->GetOperationQueueIndex(VK_QUEUE_COMPUTE_BIT);
+  else
+    std::cerr << "Device has no compute queue, GPU sprites will not be drawn" << std::endl;
+  _separate_compute = (_compute_queue_family != -1 && _compute_queue_family != graphicsQueueID);
+
+  // One queue per distinct family
+  std::vector<int> queueFamilies = {graphicsQueueID};
+  for (int family : {presentsQueueID, _compute_queue_family}) {
+    if (family != -1 && std::find(queueFamilies.begin(), queueFamilies.end(), family) == queueFamilies.end())
+      queueFamilies.push_back(family);
+  }
+  std::vector<VkDeviceQueueCreateInfo> queueCreateInfos(queueFamilies.size());
 
   float queuePriority = 1.0f;
-  for (unsigned i = 0; i < queueCount; ++i) {
+  for (size_t i = 0; i < queueFamilies.size(); ++i) {
     VkDeviceQueueCreateInfo& queueCreateInfo = queueCreateInfos[i];
     queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queueCreateInfo.queueFamilyIndex = ((i == 0) ? graphicsQueueID : presentsQueueID);
+    queueCreateInfo.queueFamilyIndex = queueFamilies[i];
     queueCreateInfo.queueCount = 1;
     queueCreateInfo.pQueuePriorities = &queuePriority;
   }
@@ -249,8 +385,44 @@ bool Renderer::InitLogicalDevice() {
 
   createInfo.pEnabledFeatures = &deviceFeatures;
 
-  createInfo.enabledExtensionCount = _vk_required_extenstions.size();
-  createInfo.ppEnabledExtensionNames = _vk_required_extenstions.data();
+  std::vector<const char*> deviceExtensions = GetRequiredExtensions();
+
+  // Lets us line up GPU timestamps with the CPU clock without stalling the queue
+  if (device->SupportsExtension(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)) {
+    auto getTimeDomains = (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT) 
+      vkGetInstanceProcAddr(_vk_instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+
+    uint32_t domainCount = 0;
+    if (getTimeDomains != nullptr) getTimeDomains(device->GetDevice(), &domainCount, nullptr);
+    std::vector<VkTimeDomainEXT> domains(domainCount);
+    if (domainCount > 0) getTimeDomains(device->GetDevice(), &domainCount, domains.data());
+
+    bool hasDevice = std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != domains.end();
+    bool hasMonotonic = std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT) != domains.end();
+    if (hasDevice && hasMonotonic) {
+      deviceExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+      _gpu_calibrated_timestamps = true;
+    }
+  }
+
+  // Puts every texture in one descriptor array so sprites don't split draws by texture
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+  indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  _bindless = device->SupportsBindlessTextures();
+  _max_textures = MAX_TEXTURES;
+  if (_bindless) {
+    deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    createInfo.pNext = &indexingFeatures;
+    _max_textures = std::min(MAX_BINDLESS_TEXTURES, device->MaxBindlessTextures());
+  }
+
+  createInfo.enabledExtensionCount = deviceExtensions.size();
+  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
   if (_enable_validation_layers) {
     createInfo.enabledLayerCount = _vk_validation_layers.size();
@@ -265,17 +437,25 @@ bool Renderer::InitLogicalDevice() {
     return false;
   }
 
-  vkGetDeviceQueue(_vk_logical_device, queueCreateInfos[0].queueFamilyIndex, 0, &_vk_graphics_queue);
+  vkGetDeviceQueue(_vk_logical_device, graphicsQueueID, 0, &_vk_graphics_queue);
+  vkGetDeviceQueue(_vk_logical_device, presentsQueueID, 0, &_vk_present_queue);
+  if (_compute_queue_family != -1)
+    vkGetDeviceQueue(_vk_logical_device, _compute_queue_family, 0, &_vk_compute_queue);
 
-  if (queueCount == 1)
-    _vk_present_queue = _vk_graphics_queue;
-  else
-    vkGetDeviceQueue(_vk_logical_device, queueCreateInfos[1].queueFamilyIndex, 0, &_vk_present_queue);
+  if (_gpu_calibrated_timestamps) {
+    _vkGetCalibratedTimestampsEXT = (PFN_vkGetCalibratedTimestampsEXT) vkGetDeviceProcAddr(_vk_logical_device, "vkGetCalibratedTimestampsEXT");
+    _gpu_calibrated_timestamps = (_vkGetCalibratedTimestampsEXT != nullptr);
+  }
 
   return true;
 }
 
 bool Renderer::InitSurface() {
+  if (_headless) {
+    _vk_surface = VK_NULL_HANDLE;
+    return true;
+  }
+
   if (glfwCreateWindowSurface(_vk_instance, _window, nullptr, &_vk_surface) != VK_SUCCESS) {
     std::cerr << "Failed to create window surface for vulkan" << std::endl;
     return false; 
@@ -284,22 +464,33 @@ bool Renderer::InitSurface() {
   return true;
 }
 
-bool Renderer::InitSwapChain() {
+bool Renderer::InitSwapChain(VkSwapchainKHR oldSwapchain) {
+  if (_headless)
+    return InitOffscreenTargets();
+
   RenderDevice* device = _device_manager.GetCurrentDevice();
+  // The surface extent changes with the window so the capabilities must be fresh
+  device->RefreshSurfaceCapabilities();
   SwapChainProperties swapchain_props = device->GetSwapChainProperties();
 
   VkSurfaceFormatKHR surfaceFormat = device->GetPreferredSwapFormat(VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR);
-  VkPresentModeKHR presentMode = device->GetPrefferedSwapMode(VK_PRESENT_MODE_MAILBOX_KHR);
+  LatencyPolicy policy = GetLatencyPolicy(_latency_mode);
+  VkPresentModeKHR presentMode = device->GetPrefferedSwapMode(policy.present_modes);
 
-  int width, height;
-  glfwGetWindowSize(_window, &width, &height);
-  
-  VkExtent2D extent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+  VkExtent2D extent = swapchain_props.capabilities.currentExtent;
+  if (extent.width == UINT32_MAX) {
+    int width = _framebuffer_width, height = _framebuffer_height;
+
+    extent.width = std::clamp(static_cast<uint32_t>(width), swapchain_props.capabilities.minImageExtent.width, 
+      swapchain_props.capabilities.maxImageExtent.width);
+    extent.height = std::clamp(static_cast<uint32_t>(height), swapchain_props.capabilities.minImageExtent.height, 
+      swapchain_props.capabilities.maxImageExtent.height);
+  }
 
   uint32_t imageCount;
   if (swapchain_props.capabilities.maxImageCount > 0) 
-    imageCount = std::min(swapchain_props.capabilities.minImageCount + 1, swapchain_props.capabilities.maxImageCount);
-  else imageCount = swapchain_props.capabilities.minImageCount + 1;
+    imageCount = std::min(swapchain_props.capabilities.minImageCount + policy.extra_images, swapchain_props.capabilities.maxImageCount);
+  else imageCount = swapchain_props.capabilities.minImageCount + policy.extra_images;
 
   VkSwapchainCreateInfoKHR createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -330,7 +521,8 @@ bool Renderer::InitSwapChain() {
   createInfo.presentMode = presentMode;
   createInfo.clipped = VK_TRUE;
 
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
+  // Handing over the old swapchain lets the presentation engine keep showing its images while we rebuild
+  createInfo.oldSwapchain = oldSwapchain;
 
   if (vkCreateSwapchainKHR(_vk_logical_device, &createInfo, nullptr, &_vk_swapchain) != VK_SUCCESS) {
     std::cerr << "Failed to create swap chain" << std::endl;
@@ -347,229 +539,312 @@ bool Renderer::InitSwapChain() {
   return true;
 }
 
-void Renderer::DestroySwapChain() {
+bool Renderer::InitOffscreenTargets() {
+  // One target per frame in flight so a frame can be read back while the next one renders
+  _vk_swapchain_image_format = VK_FORMAT_R8G8B8A8_UNORM;
+  size_t frameCount = GetLatencyPolicy(_latency_mode).frames_in_flight;
+  _vk_swapchain_images.resize(frameCount);
+  _vk_offscreen_images_memory.resize(frameCount);
 
-  vkDeviceWaitIdle(_vk_logical_device);
+  for (size_t i = 0; i < _vk_swapchain_images.size(); i++) {
+    if (!InitImage(_vk_swapchain_extent.width, _vk_swapchain_extent.height, _vk_swapchain_image_format, VK_IMAGE_TILING_OPTIMAL,
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+      _vk_swapchain_images[i], _vk_offscreen_images_memory[i]))
+      return false;
+  }
+
+  return true;
+}
+
+void Renderer::DestroyOffscreenTargets() {
+  for (size_t i = 0; i < _vk_swapchain_images.size(); i++) {
+    vkDestroyImage(_vk_logical_device, _vk_swapchain_images[i], nullptr);
+    vkFreeMemory(_vk_logical_device, _vk_offscreen_images_memory[i], nullptr);
+  }
+  _vk_swapchain_images.clear();
+  _vk_offscreen_images_memory.clear();
+}
 
+void Renderer::DestroySwapChainImages() {
   for (auto framebuffer : _vk_swapchain_framebuffers) {
     vkDestroyFramebuffer(_vk_logical_device, framebuffer, nullptr);
   }
+  _vk_swapchain_framebuffers.clear();
 
-  vkDestroyPipeline(_vk_logical_device, _vk_graphics_pipeline, nullptr);
-  vkDestroyPipelineLayout(_vk_logical_device, _vk_pipeline_layout, nullptr);
-  vkDestroyRenderPass(_vk_logical_device, _vk_render_pass, nullptr);
+  for (auto& frame : _frames) {
+    DestroyDepthFramebuffers(frame);
+  }
 
   for (auto imageView : _vk_swapchain_image_views) {
     vkDestroyImageView(_vk_logical_device, imageView, nullptr);
   }
+  _vk_swapchain_image_views.clear();
+}
 
-  vkDestroySwapchainKHR(_vk_logical_device, _vk_swapchain, nullptr);
-
-  for (size_t i = 0; i < _vk_swapchain_images.size(); i++) {
+void Renderer::DestroyUniformBuffers() {
+  for (size_t i = 0; i < _vk_uniform_buffers.size(); i++) {
     vkDestroyBuffer(_vk_logical_device, _vk_uniform_buffers[i], nullptr);
     vkFreeMemory(_vk_logical_device, _vk_uniform_buffers_memory[i], nullptr);
   }
+  _vk_uniform_buffers.clear();
+  _vk_uniform_buffers_memory.clear();
 
-  vkDestroyDescriptorPool(_vk_logical_device, _vk_descriptor_pool, nullptr);
+  // Frees the descriptor sets with them
+  for (auto pool : _vk_descriptor_pools) {
+    vkDestroyDescriptorPool(_vk_logical_device, pool, nullptr);
+  }
+  _vk_descriptor_pools.clear();
+  _vk_descriptor_sets.clear();
+  _descriptor_pool_free = 0;
 }
 
-static int cnt = 0;
+void Renderer::DestroySwapChain() {
 
-bool Renderer::ResetSwapChain() {
-  std::cout << cnt++ << std::endl;
   vkDeviceWaitIdle(_vk_logical_device);
 
-  DestroySwapChain();
+  DestroySwapChainImages();
+
+  vkDestroyPipelineLayout(_vk_logical_device, _vk_pipeline_layout, nullptr);
+  vkDestroyRenderPass(_vk_logical_device, _vk_render_pass, nullptr);
+
+  if (_headless) {
+    DestroyOffscreenTargets();
+  } else {
+    vkDestroySwapchainKHR(_vk_logical_device, _vk_swapchain, nullptr);
+  }
+
+  DestroyUniformBuffers();
+}
+
+bool Renderer::ResetSwapChain() {
+  if (!_headless) {
+    int width = _framebuffer_width, height = _framebuffer_height;
+
+    // A minimized window has no drawable area, keep the current swapchain until it comes back
+    if (width == 0 || height == 0)
+      return true;
+  }
+
+  // Only the frames still in flight can reference the framebuffers we are about to replace
+  vkWaitForFences(_vk_logical_device, static_cast<uint32_t>(_vk_in_flight_fences.size()), _vk_in_flight_fences.data(), 
+    VK_TRUE, UINT64_MAX);
+
+  VkFormat oldFormat = _vk_swapchain_image_format;
+  size_t oldImageCount = _vk_swapchain_images.size();
+  VkSwapchainKHR oldSwapchain = _vk_swapchain;
+
+  DestroySwapChainImages();
+  if (_headless)
+    DestroyOffscreenTargets();
+
+  bool ret = InitSwapChain(oldSwapchain);
+  if (!_headless)
+    vkDestroySwapchainKHR(_vk_logical_device, oldSwapchain, nullptr);
+  if (!ret) return false;
+
+  // The render pass and pipelines only depend on the image format, not the extent
+  if (_vk_swapchain_image_format != oldFormat) {
+    VkRenderPass oldRenderPass = _vk_render_pass;
+    VkPipelineLayout oldLayout = _vk_pipeline_layout;
+
+    // The manager moves its pipelines over to the new pass before the old one goes
+    bool recreated = InitRenderPass() && InitGraphicsPipeline() && WaitForPipelines();
+    vkDestroyPipelineLayout(_vk_logical_device, oldLayout, nullptr);
+    vkDestroyRenderPass(_vk_logical_device, oldRenderPass, nullptr);
+    if (!recreated)
+      return false;
+  }
+
+  // Uniform buffers and descriptor sets are per swapchain image
+  if (_vk_swapchain_images.size() != oldImageCount) {
+    DestroyUniformBuffers();
+
+    if (!InitUniformBuffers() || !InitDescriptorPool() || !InitDescriptorSets())
+      return false;
+  }
 
   if (
-     !InitSwapChain()
-  || !InitImageViews()
-  || !InitRenderPass()
-  || !InitGraphicsPipeline()
+     !InitImageViews()
   || !InitFramebuffers()
-  || !InitUniformBuffers()
-  || !InitDescriptorPool()
-  || !InitDescriptorSets()
-  || !InitCommandBuffers()
   ) { return false; }
 
   return true;
 }
 
 bool Renderer::InitGraphicsPipeline() {
-  auto vertShaderCode = LOAD_RESOURCE(default_vert_spv).data();
-  auto fragShaderCode = LOAD_RESOURCE(default_frag_spv).data();
+  // Origin the packed vertices are relative to, the other shaders ignore it
+  VkPushConstantRange pushConstantRange = {};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = shader_tables::sprite_packed_vert.push_constant_size;
 
-  VkShaderModule vertShaderModule;
-  VkShaderModule fragShaderModule;
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &_vk_descriptor_set_layout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-  if (!InitShader(vertShaderModule, vertShaderCode) || !InitShader(fragShaderModule, fragShaderCode)) {
-    vkDestroyShaderModule(_vk_logical_device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(_vk_logical_device, vertShaderModule, nullptr);
+  if (vkCreatePipelineLayout(_vk_logical_device, &pipelineLayoutInfo, nullptr, &_vk_pipeline_layout) != VK_SUCCESS) {
+    std::cerr << "Failed to create pipeline layout" << std::endl;
     return false;
   }
 
-  VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-  vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-  vertShaderStageInfo.module = vertShaderModule;
-  vertShaderStageInfo.pName = "main";
+  _pipelines.SetTarget(_vk_render_pass, _vk_pipeline_layout);
 
-  VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-  fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  fragShaderStageInfo.module = fragShaderModule;
-  fragShaderStageInfo.pName = "main";
+  // The bindless shader picks the texture per fragment, the default one samples whatever set is bound
+  PipelineState state;
+  state.fragment = _bindless ? FragmentShader::SpriteBindless : FragmentShader::Sprite;
 
-  VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+  state.vertex = VertexShader::Sprite;
+  int32_t spritePipeline = _pipelines.Register(state);
+  state.vertex = VertexShader::SpritePacked;
+  int32_t packedPipeline = _pipelines.Register(state);
+  state.vertex = VertexShader::Instanced;
+  int32_t instancedPipeline = _pipelines.Register(state);
 
-  VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-  vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  if (spritePipeline < 0 || packedPipeline < 0 || instancedPipeline < 0)
+    return false;
 
-  auto bindingDescription = Vertex::GetBindingDescription();
-  auto attributeDescriptions = Vertex::GetAttributeDescriptions();
+  _sprite_pipeline = static_cast<uint32_t>(spritePipeline);
+  _instanced_pipeline = static_cast<uint32_t>(instancedPipeline);
+  // The background quad is always a full Vertex, sprites and tiles follow _vertex_format
+  _stream_pipeline = (_vertex_format == VertexFormat::Packed) ? static_cast<uint32_t>(packedPipeline) : _sprite_pipeline;
+  _opaque_pipeline = _stream_pipeline;
+  _translucent_pipeline = _stream_pipeline;
+
+  // Only sprites use depth, what's drawn before them is behind every layer anyway. Opaque sprites discard
+  // transparent texels instead of blending so they don't write depth where they show nothing.
+  if (_depth_layering) {
+    state.vertex = (_vertex_format == VertexFormat::Packed) ? VertexShader::SpritePacked : VertexShader::Sprite;
+    state.depth_test = true;
+    int32_t translucentPipeline = _pipelines.Register(state);
+
+    state.fragment = _bindless ? FragmentShader::SpriteBindlessCutout : FragmentShader::SpriteCutout;
+    state.blend = BlendMode::Opaque;
+    state.depth_write = true;
+    int32_t opaquePipeline = _pipelines.Register(state);
+
+    if (translucentPipeline < 0 || opaquePipeline < 0)
+      return false;
 
-  vertexInputInfo.vertexBindingDescriptionCount = 1;
-  vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-  vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+    _opaque_pipeline = static_cast<uint32_t>(opaquePipeline);
+    _translucent_pipeline = static_cast<uint32_t>(translucentPipeline);
+  }
 
-  VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-  inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-  inputAssembly.primitiveRestartEnable = VK_FALSE;
+  // Every frame needs these, they're built while the rest of the renderer is set up and waited for at the end
+  _pipelines.Get(_sprite_pipeline);
+  _pipelines.Get(_stream_pipeline);
+  _pipelines.Get(_instanced_pipeline);
+  _pipelines.Get(_opaque_pipeline);
+  _pipelines.Get(_translucent_pipeline);
 
-  VkViewport viewport = {};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = static_cast<float>(_vk_swapchain_extent.width);
-  viewport.height = static_cast<float>(_vk_swapchain_extent.height);
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
+  return true;
+}
 
-  VkRect2D scissor = {};
-  scissor.offset = {0, 0};
-  scissor.extent = _vk_swapchain_extent;
+bool Renderer::WaitForPipelines() {
+  if (_pipelines.Wait(_sprite_pipeline) == VK_NULL_HANDLE || _pipelines.Wait(_stream_pipeline) == VK_NULL_HANDLE
+    || _pipelines.Wait(_instanced_pipeline) == VK_NULL_HANDLE || _pipelines.Wait(_opaque_pipeline) == VK_NULL_HANDLE
+    || _pipelines.Wait(_translucent_pipeline) == VK_NULL_HANDLE) {
+    std::cerr << "Failed to create graphics pipelines" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool Renderer::InitCullPipeline() {
+  // Without a compute queue there is nothing to run this on, GPU sprites are skipped instead
+  if (_compute_queue_family == -1)
+    return true;
+
+  // Every sprite, the survivors, and the indirect draw they are counted into
+  std::vector<VkDescriptorSetLayoutBinding> bindings;
+  std::vector<VkDescriptorBindingFlagsEXT> bindingFlags;
+  if (!MergeBindings({&shader_tables::cull_comp}, 0, bindings, bindingFlags))
+    return false;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  if (vkCreateDescriptorSetLayout(_vk_logical_device, &layoutInfo, nullptr, &_vk_cull_descriptor_set_layout) != VK_SUCCESS) {
+    std::cerr << "Failed to create cull descriptor set layout" << std::endl;
+    return false;
+  }
 
-  VkPipelineViewportStateCreateInfo viewportState = {};
-  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-  viewportState.viewportCount = 1;
-  viewportState.pViewports = &viewport;
-  viewportState.scissorCount = 1;
-  viewportState.pScissors = &scissor;
-
-  VkPipelineRasterizationStateCreateInfo rasterizer = {};
-  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-  rasterizer.depthClampEnable = VK_FALSE;
-  rasterizer.rasterizerDiscardEnable = VK_FALSE;
-  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-  rasterizer.lineWidth = 1.0f;
-  rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-  rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-  rasterizer.depthBiasEnable = VK_FALSE;
-
-  VkPipelineMultisampleStateCreateInfo multisampling = {};
-  multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-  multisampling.sampleShadingEnable = VK_FALSE;
-  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-  VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-  colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  colorBlendAttachment.blendEnable = VK_TRUE;
-  colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-  colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-  colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-  colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-  colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-  colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-
-  VkPipelineColorBlendStateCreateInfo colorBlending = {};
-  colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-  colorBlending.logicOpEnable = VK_FALSE;
-  colorBlending.logicOp = VK_LOGIC_OP_COPY;
-  colorBlending.attachmentCount = 1;
-  colorBlending.pAttachments = &colorBlendAttachment;
-  colorBlending.blendConstants[0] = 0.0f;
-  colorBlending.blendConstants[1] = 0.0f;
-  colorBlending.blendConstants[2] = 0.0f;
-  colorBlending.blendConstants[3] = 0.0f;
+  VkPushConstantRange pushConstantRange = {};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = shader_tables::cull_comp.push_constant_size;
 
   VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   pipelineLayoutInfo.setLayoutCount = 1;
-  pipelineLayoutInfo.pSetLayouts = &_vk_descriptor_set_layout;
-  pipelineLayoutInfo.pushConstantRangeCount = 0;
-
-  bool ret = true;
-  if (vkCreatePipelineLayout(_vk_logical_device, &pipelineLayoutInfo, nullptr, &_vk_pipeline_layout) != VK_SUCCESS) {
-    std::cerr << "Failed to create pipeline layout" << std::endl;
-    ret = false;
-  }
+  pipelineLayoutInfo.pSetLayouts = &_vk_cull_descriptor_set_layout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-  if (ret) {
-    VkGraphicsPipelineCreateInfo pipelineInfo = {};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssembly;
-    pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &rasterizer;
-    pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.layout = _vk_pipeline_layout;
-    pipelineInfo.renderPass = _vk_render_pass;
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-    if (vkCreateGraphicsPipelines(_vk_logical_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_vk_graphics_pipeline) != VK_SUCCESS) {
-     std::cerr << "Failed to create graphics pipeline" << std::endl;
-     ret = false;
-    }
+  if (vkCreatePipelineLayout(_vk_logical_device, &pipelineLayoutInfo, nullptr, &_vk_cull_pipeline_layout) != VK_SUCCESS) {
+    std::cerr << "Failed to create cull pipeline layout" << std::endl;
+    return false;
   }
 
-  vkDestroyShaderModule(_vk_logical_device, fragShaderModule, nullptr);
-  vkDestroyShaderModule(_vk_logical_device, vertShaderModule, nullptr);
+  Resource cullShaderCode = LOAD_RESOURCE(cull_comp_spv);
 
-  return ret;
-}
+  VkShaderModule cullShaderModule;
+  if (!InitShaderModule(_vk_logical_device, cullShaderModule, cullShaderCode))
+    return false;
 
-bool Renderer::InitShader(VkShaderModule& shader_module, const std::vector<char>& code) {
-  VkShaderModuleCreateInfo createInfo = {};
-  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = code.size();
-  createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+  VkComputePipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = cullShaderModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = _vk_cull_pipeline_layout;
 
-  if (vkCreateShaderModule(_vk_logical_device, &createInfo, nullptr, &shader_module) != VK_SUCCESS) {
-    std::cerr << "Failed to create shader module" << std::endl;
-    return false;
+  bool ret = true;
+  if (vkCreateComputePipelines(_vk_logical_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_vk_cull_pipeline) != VK_SUCCESS) {
+    std::cerr << "Failed to create cull pipeline" << std::endl;
+    ret = false;
   }
 
-  return true;
+  vkDestroyShaderModule(_vk_logical_device, cullShaderModule, nullptr);
+
+  return ret;
 }
 
 bool Renderer::InitDescriptorSetLayout() {
-  VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-  uboLayoutBinding.binding = 0;
-  uboLayoutBinding.descriptorCount = 1;
-  uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  uboLayoutBinding.pImmutableSamplers = nullptr;
-  uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-  VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
-  samplerLayoutBinding.binding = 1;
-  samplerLayoutBinding.descriptorCount = 1;
-  samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  samplerLayoutBinding.pImmutableSamplers = nullptr;
-  samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-  std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
+  // Every graphics pipeline shares this layout, so it covers all of their stages
+  std::vector<VkDescriptorSetLayoutBinding> bindings;
+  std::vector<VkDescriptorBindingFlagsEXT> bindingFlags;
+  if (!MergeBindings({&shader_tables::sprite_vert, &shader_tables::sprite_packed_vert, &shader_tables::instanced_vert,
+    _bindless ? &shader_tables::sprite_bindless_frag : &shader_tables::sprite_frag}, _max_textures, bindings, bindingFlags))
+    return false;
+
   VkDescriptorSetLayoutCreateInfo layoutInfo = {};
   layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
   layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
   layoutInfo.pBindings = bindings.data();
 
+  // Only the registered textures are ever written, the rest of the texture array stays unbound
+  VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+  bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+  bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+  bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+  // New textures are written into the array while frames that don't sample them are in flight
+  if (_bindless) {
+    for (auto& flags : bindingFlags) {
+      if (flags & VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT)
+        flags |= VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+    }
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    layoutInfo.pNext = &bindingFlagsInfo;
+  }
+
   if (vkCreateDescriptorSetLayout(_vk_logical_device, &layoutInfo, nullptr, &_vk_descriptor_set_layout) != VK_SUCCESS) {
     std::cerr << "Failed to create descriptor set layout" << std::endl;
     return false;
@@ -579,51 +854,90 @@ bool Renderer::InitDescriptorSetLayout() {
 }
 
 bool Renderer::InitDescriptorPool() {
+  // Bindless needs one set per image, otherwise there's a set per image and texture. Those get room for
+  // twice the textures there are so streamed pages rarely need another pool.
+  size_t slots = _bindless ? 1 : std::max(MIN_TEXTURE_SLOTS, _textures.size() * 2);
+  return AddDescriptorPool(static_cast<uint32_t>(_vk_swapchain_images.size() * slots));
+}
+
+bool Renderer::AddDescriptorPool(uint32_t setCount) {
   std::array<VkDescriptorPoolSize, 2> poolSizes = {};
   poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  poolSizes[0].descriptorCount = static_cast<uint32_t>(_vk_swapchain_images.size());
+  poolSizes[0].descriptorCount = setCount;
   poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  poolSizes[1].descriptorCount = static_cast<uint32_t>(_vk_swapchain_images.size());
+  poolSizes[1].descriptorCount = _bindless ? setCount * _max_textures : setCount;
 
   VkDescriptorPoolCreateInfo poolInfo = {};
   poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
   poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
   poolInfo.pPoolSizes = poolSizes.data();
-  poolInfo.maxSets = static_cast<uint32_t>(_vk_swapchain_images.size());
+  poolInfo.maxSets = setCount;
+
+  if (_bindless)
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
 
-  if (vkCreateDescriptorPool(_vk_logical_device, &poolInfo, nullptr, &_vk_descriptor_pool) != VK_SUCCESS) {
+  VkDescriptorPool pool;
+  if (vkCreateDescriptorPool(_vk_logical_device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
     std::cerr << "Failed to create descriptor pool" << std::endl;
     return false;
   }
+
+  _vk_descriptor_pools.push_back(pool);
+  _descriptor_pool_free = setCount;
   
   return true;
 }
 
-bool Renderer::InitDescriptorSets() {
-  std::vector<VkDescriptorSetLayout> layouts(_vk_swapchain_images.size(), _vk_descriptor_set_layout);
+bool Renderer::AllocateDescriptorSets(size_t count) {
+  // Full pools keep their sets, the new one has room for as many again
+  if (count > _descriptor_pool_free && !AddDescriptorPool(static_cast<uint32_t>(std::max(count, _vk_descriptor_sets.size()))))
+    return false;
+
+  std::vector<VkDescriptorSetLayout> layouts(count, _vk_descriptor_set_layout);
   VkDescriptorSetAllocateInfo allocInfo = {};
   allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  allocInfo.descriptorPool = _vk_descriptor_pool;
-  allocInfo.descriptorSetCount = static_cast<uint32_t>(_vk_swapchain_images.size());
+  allocInfo.descriptorPool = _vk_descriptor_pools.back();
+  allocInfo.descriptorSetCount = static_cast<uint32_t>(count);
   allocInfo.pSetLayouts = layouts.data();
 
-  _vk_descriptor_sets.resize(_vk_swapchain_images.size());
-  if (vkAllocateDescriptorSets(_vk_logical_device, &allocInfo, _vk_descriptor_sets.data()) != VK_SUCCESS) {
+  size_t first = _vk_descriptor_sets.size();
+  _vk_descriptor_sets.resize(first + count);
+  if (vkAllocateDescriptorSets(_vk_logical_device, &allocInfo, &_vk_descriptor_sets[first]) != VK_SUCCESS) {
     std::cerr << "Failed to allocate descriptor sets" << std::endl;
+    _vk_descriptor_sets.resize(first);
     return false;
   }
 
-  for (size_t i = 0; i < _vk_swapchain_images.size(); i++) {
+  _descriptor_pool_free -= static_cast<uint32_t>(count);
+  return true;
+}
+
+bool Renderer::InitDescriptorSets() {
+  size_t setsPerImage = _bindless ? 1 : _textures.size();
+  if (!AllocateDescriptorSets(_vk_swapchain_images.size() * setsPerImage))
+    return false;
+
+  WriteDescriptorSets(0);
+  return true;
+}
+
+// Sets go texture by texture, each texture has one per image
+void Renderer::WriteDescriptorSets(size_t first) {
+  size_t imageCount = _vk_swapchain_images.size();
+
+  std::vector<VkDescriptorImageInfo> imageInfos(_textures.size());
+  for (size_t i = 0; i < _textures.size(); i++) {
+    imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfos[i].imageView = GetTextureView(static_cast<uint32_t>(i));
+    imageInfos[i].sampler = _vk_texture_sampler;
+  }
+
+  for (size_t i = first; i < _vk_descriptor_sets.size(); i++) {
     VkDescriptorBufferInfo bufferInfo = {};
-    bufferInfo.buffer = _vk_uniform_buffers[i];
+    bufferInfo.buffer = _vk_uniform_buffers[i % imageCount];
     bufferInfo.offset = 0;
     bufferInfo.range = sizeof(UniformBufferObject);
 
-    VkDescriptorImageInfo imageInfo = {};
-    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageInfo.imageView = _vk_texture_image_view;
-    imageInfo.sampler = _vk_texture_sampler;
-
     std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
 
     descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -634,17 +948,70 @@ bool Renderer::InitDescriptorSets() {
     descriptorWrites[0].descriptorCount = 1;
     descriptorWrites[0].pBufferInfo = &bufferInfo;
 
+    // Bindless sets get the whole array, the others just their own texture
     descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[1].dstSet = _vk_descriptor_sets[i];
     descriptorWrites[1].dstBinding = 1;
     descriptorWrites[1].dstArrayElement = 0;
     descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descriptorWrites[1].descriptorCount = 1;
-    descriptorWrites[1].pImageInfo = &imageInfo;
+    descriptorWrites[1].descriptorCount = _bindless ? static_cast<uint32_t>(imageInfos.size()) : 1;
+    descriptorWrites[1].pImageInfo = _bindless ? imageInfos.data() : &imageInfos[i / imageCount];
 
     vkUpdateDescriptorSets(_vk_logical_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
   }
+}
+
+VkDescriptorSet Renderer::GetDescriptorSet(uint32_t imageIndex, uint32_t texture) const {
+  if (_bindless)
+    return _vk_descriptor_sets[imageIndex];
+
+  // Unknown and released textures draw with the atlas rather than reading past the sets
+  size_t set = texture * _vk_swapchain_images.size() + imageIndex;
+  if (set >= _vk_descriptor_sets.size() || _textures[texture].view == VK_NULL_HANDLE || _textures[texture].retired)
+    set = imageIndex;
+
+  return _vk_descriptor_sets[set];
+}
+
+VkImageView Renderer::GetTextureView(uint32_t texture) const {
+  // Released slots point at the atlas so every descriptor stays valid
+  if (texture >= _textures.size() || _textures[texture].view == VK_NULL_HANDLE || _textures[texture].retired)
+    return _textures[0].view;
+
+  return _textures[texture].view;
+}
 
+// Only called for slots no frame in flight samples, so it doesn't wait for them. Their own sets aren't bound,
+// and the bindless array is update after bind.
+bool Renderer::UpdateTextureDescriptors(uint32_t texture) {
+  // A texture in a new slot gets sets of its own
+  size_t slotSets = (texture + 1) * _vk_swapchain_images.size();
+  if (!_bindless && _vk_descriptor_sets.size() < slotSets) {
+    size_t first = _vk_descriptor_sets.size();
+    if (!AllocateDescriptorSets(slotSets - first))
+      return false;
+
+    WriteDescriptorSets(first);
+    return true;
+  }
+
+  VkDescriptorImageInfo imageInfo = {};
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  imageInfo.imageView = GetTextureView(texture);
+  imageInfo.sampler = _vk_texture_sampler;
+
+  std::vector<VkWriteDescriptorSet> descriptorWrites(_vk_swapchain_images.size());
+  for (size_t i = 0; i < descriptorWrites.size(); i++) {
+    descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[i].dstSet = _vk_descriptor_sets[_bindless ? i : texture * descriptorWrites.size() + i];
+    descriptorWrites[i].dstBinding = 1;
+    descriptorWrites[i].dstArrayElement = _bindless ? texture : 0;
+    descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrites[i].descriptorCount = 1;
+    descriptorWrites[i].pImageInfo = &imageInfo;
+  }
+
+  vkUpdateDescriptorSets(_vk_logical_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
   return true;
 }
 
@@ -656,36 +1023,43 @@ bool Renderer::InitRenderPass() {
   colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
   colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  // The frame's render graph moves the image into and out of attachment layout around the pass
+  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
   VkAttachmentReference colorAttachmentRef = {};
   colorAttachmentRef.attachment = 0;
   colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+  // Cleared every frame and never read after the pass, so it isn't stored
+  VkAttachmentDescription depthAttachment = {};
+  depthAttachment.format = DEPTH_FORMAT;
+  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference depthAttachmentRef = {};
+  depthAttachmentRef.attachment = 1;
+  depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
   VkSubpassDescription subpass = {};
   subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
   subpass.colorAttachmentCount = 1;
   subpass.pColorAttachments = &colorAttachmentRef;
+  subpass.pDepthStencilAttachment = (_depth_layering) ? &depthAttachmentRef : nullptr;
 
-
-  VkSubpassDependency dependency = {};
-  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-  dependency.dstSubpass = 0;
-  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.srcAccessMask = 0;
-  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
+  std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
 
   VkRenderPassCreateInfo renderPassInfo = {};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  renderPassInfo.attachmentCount = 1;
-  renderPassInfo.pAttachments = &colorAttachment;
+  renderPassInfo.attachmentCount = (_depth_layering) ? 2 : 1;
+  renderPassInfo.pAttachments = attachments.data();
   renderPassInfo.subpassCount = 1;
   renderPassInfo.pSubpasses = &subpass;
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
 
   if (vkCreateRenderPass(_vk_logical_device, &renderPassInfo, nullptr, &_vk_render_pass) != VK_SUCCESS) {
     std::cerr << "Failed to create render pass" << std::endl;
@@ -696,6 +1070,9 @@ bool Renderer::InitRenderPass() {
 }
 
 bool Renderer::InitFramebuffers() {
+  // With depth layering every frame pairs the images with its own depth image instead, see GetFramebuffer
+  if (_depth_layering) return true;
+
   _vk_swapchain_framebuffers.resize(_vk_swapchain_image_views.size());
 
   for (size_t i = 0; i < _vk_swapchain_image_views.size(); i++) {
@@ -721,6 +1098,50 @@ bool Renderer::InitFramebuffers() {
   return true;
 }
 
+VkFramebuffer Renderer::GetFramebuffer(FrameResources& frame, uint32_t imageIndex, VkImageView depthView) {
+  if (!_depth_layering) return _vk_swapchain_framebuffers[imageIndex];
+
+  // The frame's render graph replaces its depth image when the extent changes. Only this frame used the
+  // old framebuffers and its fence has signalled.
+  if (depthView != frame.depth_view) {
+    DestroyDepthFramebuffers(frame);
+    frame.depth_view = depthView;
+  }
+
+  frame.depth_framebuffers.resize(_vk_swapchain_image_views.size(), VK_NULL_HANDLE);
+  VkFramebuffer& framebuffer = frame.depth_framebuffers[imageIndex];
+  if (framebuffer != VK_NULL_HANDLE) return framebuffer;
+
+  VkImageView attachments[] = {
+    _vk_swapchain_image_views[imageIndex],
+    depthView
+  };
+
+  VkFramebufferCreateInfo framebufferInfo = {};
+  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferInfo.renderPass = _vk_render_pass;
+  framebufferInfo.attachmentCount = 2;
+  framebufferInfo.pAttachments = attachments;
+  framebufferInfo.width = _vk_swapchain_extent.width;
+  framebufferInfo.height = _vk_swapchain_extent.height;
+  framebufferInfo.layers = 1;
+
+  if (vkCreateFramebuffer(_vk_logical_device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+    std::cerr << "Failed to create framebuffer" << std::endl;
+    framebuffer = VK_NULL_HANDLE;
+  }
+
+  return framebuffer;
+}
+
+void Renderer::DestroyDepthFramebuffers(FrameResources& frame) {
+  for (auto framebuffer : frame.depth_framebuffers) {
+    vkDestroyFramebuffer(_vk_logical_device, framebuffer, nullptr);
+  }
+  frame.depth_framebuffers.clear();
+  frame.depth_view = VK_NULL_HANDLE;
+}
+
 bool Renderer::InitCommandPool() {
   VkCommandPoolCreateInfo poolInfo = {};
   poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -735,46 +1156,143 @@ bool Renderer::InitCommandPool() {
 }
 
 bool Renderer::InitTextureImage() {
-  int texWidth, texHeight, texChannels;
-  stbi_uc* pixels = stbi_load("Atlas.png", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-  VkDeviceSize imageSize = texWidth * texHeight * 4;
-
-  if (!pixels) {
+  const Image& atlas = _atlas.get();
+  if (!atlas.Valid()) {
     std::cerr << "Failed to load texture image" << std::endl;
     return false;
   }
 
+  // The atlas is always texture 0
+  bool created = CreateTexture(atlas.pixels.get(), atlas.width, atlas.height) == 0;
+  _atlas = {};
+
+  return created;
+}
+
+int32_t Renderer::LoadTexture(const char* path) {
+  // Blocks, use the asset loader's callbacks to keep loading off this thread
+  const Image& image = _asset_loader.LoadImage(path).get();
+  if (!image.Valid())
+    return -1;
+
+  return CreateTexture(image.pixels.get(), image.width, image.height);
+}
+
+int32_t Renderer::CreateTexture(const void* pixels, uint32_t width, uint32_t height) {
+  // Texture ids have to fit the 16 bits the packed vertex and the sort key give them
+  size_t used = std::count_if(_textures.begin(), _textures.end(), [](const Texture& t) { return t.view != VK_NULL_HANDLE; });
+  if (used >= _max_textures) {
+    std::cerr << "Failed to create texture, limit of " << _max_textures << " reached" << std::endl;
+    return -1;
+  }
+
+  Texture texture;
+  if (!UploadTexture(texture, pixels, width, height)) {
+    DestroyTexture(texture);
+    return -1;
+  }
+
+  // Released slots are reused before the registry grows, retired ones only once they're freed
+  uint32_t id = 1;
+  while (id < _textures.size() && _textures[id].view != VK_NULL_HANDLE)
+    id++;
+
+  // Textures created during Init are written when the descriptor sets are first made
+  if (id < _textures.size()) _textures[id] = texture;
+  else _textures.push_back(texture);
+
+  if (!_vk_descriptor_sets.empty() && !UpdateTextureDescriptors(id))
+    return -1;
+
+  return static_cast<int32_t>(id);
+}
+
+void Renderer::ReleaseTexture(uint32_t texture) {
+  if (texture == 0 || texture >= _textures.size() || _textures[texture].view == VK_NULL_HANDLE || _textures[texture].retired)
+    return;
+
+  // Frames in flight may still sample it, the frame being prepared frees it once its fence signals
+  _textures[texture].retired = true;
+  if (_preparing_frame) {
+    _preparing_frame->retired_textures.push_back(texture);
+    return;
+  }
+
+  // Outside a frame no single fence covers the last submit
+  if (!_vk_in_flight_fences.empty())
+    vkWaitForFences(_vk_logical_device, static_cast<uint32_t>(_vk_in_flight_fences.size()), _vk_in_flight_fences.data(), VK_TRUE, UINT64_MAX);
+
+  DestroyTexture(_textures[texture]);
+  if (!_vk_descriptor_sets.empty())
+    UpdateTextureDescriptors(texture);
+}
+
+bool Renderer::UploadTexture(Texture& texture, const void* pixels, uint32_t width, uint32_t height) {
+  VkDeviceSize imageSize = static_cast<VkDeviceSize>(width) * height * 4;
+  texture.width = width;
+  texture.height = height;
+
   VkBuffer stagingBuffer;
   VkDeviceMemory stagingBufferMemory;
-  InitBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+  if (!InitBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory))
+    return false;
 
   void* data;
   vkMapMemory(_vk_logical_device, stagingBufferMemory, 0, imageSize, 0, &data);
       memcpy(data, pixels, static_cast<size_t>(imageSize));
   vkUnmapMemory(_vk_logical_device, stagingBufferMemory);
 
-  stbi_image_free(pixels);
+  // The view comes first, once the copy is recorded nothing can fail and destroy the image under it
+  bool uploaded = InitImage(width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | 
+    VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.memory)
+    && InitImageView(texture.view, texture.image, VK_FORMAT_R8G8B8A8_UNORM);
+
+  // Both transitions and the copy go in the frame being prepared, outside a frame in one blocking submit
+  if (uploaded) {
+    VkCommandBuffer commandBuffer = _preparing_frame ? BeginFrameUploads(*_preparing_frame) : BeginSingleTimeCommands();
+    TransitionImageLayout(commandBuffer, texture.image, Access::None, Access::TransferDst);
+    CopyBufferToImage(commandBuffer, stagingBuffer, texture.image, width, height);
+    TransitionImageLayout(commandBuffer, texture.image, Access::TransferDst, Access::SampledFragment);
+    if (!_preparing_frame)
+      EndSingleTimeCommands(commandBuffer);
+  }
 
-  if (!InitImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | 
-    VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _vk_texture_image, _vk_texture_image_memory))
-    return false;
+  if (uploaded && _preparing_frame) {
+    _preparing_frame->retired_buffers.push_back({stagingBuffer, stagingBufferMemory});
+  } else {
+    vkDestroyBuffer(_vk_logical_device, stagingBuffer, nullptr);
+    vkFreeMemory(_vk_logical_device, stagingBufferMemory, nullptr);
+  }
 
-  if (!TransitionImageLayout(_vk_texture_image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL))
-    return false;
-      
-    CopyBufferToImage(stagingBuffer, _vk_texture_image, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+  return uploaded;
+}
 
-  if (!TransitionImageLayout(_vk_texture_image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL))
-    return false;
+void Renderer::DestroyTexture(Texture& texture) {
+  vkDestroyImageView(_vk_logical_device, texture.view, nullptr);
+  vkDestroyImage(_vk_logical_device, texture.image, nullptr);
+  vkFreeMemory(_vk_logical_device, texture.memory, nullptr);
+  texture = Texture();
+}
 
-  vkDestroyBuffer(_vk_logical_device, stagingBuffer, nullptr);
-  vkFreeMemory(_vk_logical_device, stagingBufferMemory, nullptr);
+VkCommandBuffer Renderer::BeginFrameUploads(FrameResources& frame) {
+  if (frame.uploads_recorded)
+    return frame.upload_buffer;
 
-  return true;
+  // The frame's fence has signaled, so the uploads last recorded here are done
+  vkResetCommandPool(_vk_logical_device, frame.upload_pool, 0);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  vkBeginCommandBuffer(frame.upload_buffer, &beginInfo);
+  frame.uploads_recorded = true;
+
+  return frame.upload_buffer;
 }
 
-bool Renderer::InitTextureImageView() {
-  return InitImageView(_vk_texture_image_view, _vk_texture_image, VK_FORMAT_R8G8B8A8_UNORM);
+bool Renderer::BindlessTextures() const {
+  return _bindless;
 }
 
 bool Renderer::InitTextureSampler() {
@@ -829,7 +1347,8 @@ bool Renderer::InitImage(uint32_t width, uint32_t height, VkFormat format, VkIma
   allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
   allocInfo.allocationSize = memRequirements.size;
 
-  if (int idx = _device_manager.GetCurrentDevice()->GetMemoryTypeIndex(memRequirements.memoryTypeBits, properties) >= 0) {
+  int idx = _device_manager.GetCurrentDevice()->GetMemoryTypeIndex(memRequirements.memoryTypeBits, properties);
+  if (idx >= 0) {
     allocInfo.memoryTypeIndex = idx;
   } else {
     std::cerr << "Failed to find suitable memory type" << std::endl;
@@ -877,118 +1396,969 @@ bool Renderer::InitImageViews() {
   return true;
 }
 
-bool Renderer::TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
-  VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
+void Renderer::TransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, Access from, Access to) {
+  RenderGraph::RecordTransition(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, from, to);
+}
 
-  VkImageMemoryBarrier barrier = {};
-  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  barrier.oldLayout = oldLayout;
-  barrier.newLayout = newLayout;
-  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.image = image;
-  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  barrier.subresourceRange.baseMipLevel = 0;
-  barrier.subresourceRange.levelCount = 1;
-  barrier.subresourceRange.baseArrayLayer = 0;
-  barrier.subresourceRange.layerCount = 1;
-
-  VkPipelineStageFlags sourceStage;
-  VkPipelineStageFlags destinationStage;
-
-  if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-    barrier.srcAccessMask = 0;
-    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-    sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-  } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+bool Renderer::InitCommandBuffers() {
+  _frames.resize(GetLatencyPolicy(_latency_mode).frames_in_flight);
 
-    sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-  } else {
-    std::cerr << "Unsupported layout transition" << std::endl;
-    return false;
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = _device_manager.GetOperationQueueIndex(VK_QUEUE_GRAPHICS_BIT);
+
+  for (auto& frame : _frames) {
+    if (vkCreateCommandPool(_vk_logical_device, &poolInfo, nullptr, &frame.command_pool) != VK_SUCCESS) {
+      std::cerr << "Failed to create vulkan command pool" << std::endl;
+      return false;
+    }
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = frame.command_pool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(_vk_logical_device, &allocInfo, &frame.command_buffer) != VK_SUCCESS) {
+      std::cerr << "Failed to allocate vulkan command buffers" << std::endl;
+      return false;
+    }
+
+    // Its own pool since the frame's is reset when recording starts, after the uploads are made
+    if (vkCreateCommandPool(_vk_logical_device, &poolInfo, nullptr, &frame.upload_pool) != VK_SUCCESS) {
+      std::cerr << "Failed to create vulkan command pool" << std::endl;
+      return false;
+    }
+
+    allocInfo.commandPool = frame.upload_pool;
+
+    if (vkAllocateCommandBuffers(_vk_logical_device, &allocInfo, &frame.upload_buffer) != VK_SUCCESS) {
+      std::cerr << "Failed to allocate vulkan command buffers" << std::endl;
+      return false;
+    }
+
+    frame.secondary_pools.resize(_workers.Concurrency(), VK_NULL_HANDLE);
+    frame.secondary_buffers.resize(_workers.Concurrency(), VK_NULL_HANDLE);
+
+    for (size_t i = 0; i < frame.secondary_pools.size(); i++) {
+      if (vkCreateCommandPool(_vk_logical_device, &poolInfo, nullptr, &frame.secondary_pools[i]) != VK_SUCCESS) {
+        std::cerr << "Failed to create vulkan command pool" << std::endl;
+        return false;
+      }
+
+      allocInfo.commandPool = frame.secondary_pools[i];
+      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+      if (vkAllocateCommandBuffers(_vk_logical_device, &allocInfo, &frame.secondary_buffers[i]) != VK_SUCCESS) {
+        std::cerr << "Failed to allocate vulkan command buffers" << std::endl;
+        return false;
+      }
+    }
+
+    if (!ReserveSpriteBuffer(frame, MIN_SPRITE_CAPACITY))
+      return false;
+
+    frame.graph = std::make_unique<RenderGraph>();
+    frame.graph->Init(_vk_logical_device, _device_manager.GetCurrentDevice());
+
+    // The cull pass gets its own submit on a compute-only family, the graphics submit waits on it
+    if (_separate_compute) {
+      VkCommandPoolCreateInfo computePoolInfo = poolInfo;
+      computePoolInfo.queueFamilyIndex = _compute_queue_family;
+
+      if (vkCreateCommandPool(_vk_logical_device, &computePoolInfo, nullptr, &frame.compute_pool) != VK_SUCCESS) {
+        std::cerr << "Failed to create vulkan command pool" << std::endl;
+        return false;
+      }
+
+      allocInfo.commandPool = frame.compute_pool;
+      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+      if (vkAllocateCommandBuffers(_vk_logical_device, &allocInfo, &frame.compute_buffer) != VK_SUCCESS) {
+        std::cerr << "Failed to allocate vulkan command buffers" << std::endl;
+        return false;
+      }
+
+      VkSemaphoreCreateInfo semaphoreInfo = {};
+      semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+      if (vkCreateSemaphore(_vk_logical_device, &semaphoreInfo, nullptr, &frame.compute_finished) != VK_SUCCESS) {
+        std::cerr << "Failed to create synchronization objects for a frame" << std::endl;
+        return false;
+      }
+
+      frame.compute_graph = std::make_unique<RenderGraph>();
+      frame.compute_graph->Init(_vk_logical_device, _device_manager.GetCurrentDevice());
+    }
+  }
+
+  // One cull descriptor set per frame, written once the frame has buffers for the current sprite set
+  if (_compute_queue_family != -1) {
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = static_cast<uint32_t>(_frames.size() * 3);
+
+    VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
+    descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolInfo.poolSizeCount = 1;
+    descriptorPoolInfo.pPoolSizes = &poolSize;
+    descriptorPoolInfo.maxSets = static_cast<uint32_t>(_frames.size());
+
+    if (vkCreateDescriptorPool(_vk_logical_device, &descriptorPoolInfo, nullptr, &_vk_cull_descriptor_pool) != VK_SUCCESS) {
+      std::cerr << "Failed to create descriptor pool" << std::endl;
+      return false;
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(_frames.size(), _vk_cull_descriptor_set_layout);
+    std::vector<VkDescriptorSet> sets(_frames.size());
+
+    VkDescriptorSetAllocateInfo setInfo = {};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = _vk_cull_descriptor_pool;
+    setInfo.descriptorSetCount = static_cast<uint32_t>(sets.size());
+    setInfo.pSetLayouts = layouts.data();
+
+    if (vkAllocateDescriptorSets(_vk_logical_device, &setInfo, sets.data()) != VK_SUCCESS) {
+      std::cerr << "Failed to allocate descriptor sets" << std::endl;
+      return false;
+    }
+
+    for (size_t i = 0; i < _frames.size(); i++) {
+      _frames[i].cull_descriptor_set = sets[i];
+    }
   }
 
-  vkCmdPipelineBarrier(
-      commandBuffer,
-      sourceStage, destinationStage,
-      0,
-      0, nullptr,
-      0, nullptr,
-      1, &barrier
-  );
+  return InitTimestampQueries();
+}
 
+bool Renderer::InitTimestampQueries() {
+  RenderDevice* device = _device_manager.GetCurrentDevice();
+  uint32_t validBits = device->TimestampValidBits(_device_manager.GetOperationQueueIndex(VK_QUEUE_GRAPHICS_BIT));
+
+  // Not an error, the profiler just won't get a GPU track
+  if (validBits == 0 || device->TimestampPeriod() == 0.0f) {
+    std::cerr << "GPU timestamps not supported on the graphics queue" << std::endl;
+    _gpu_timestamps = false;
+    return true;
+  }
+
+  _gpu_timestamps = true;
+  _gpu_timestamp_period = device->TimestampPeriod();
+  _gpu_timestamp_mask = (validBits >= 64) ? UINT64_MAX : ((uint64_t(1) << validBits) - 1);
+
+  VkQueryPoolCreateInfo queryPoolInfo = {};
+  queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  queryPoolInfo.queryCount = MAX_GPU_ZONES * 2;
+
+  for (auto& frame : _frames) {
+    if (vkCreateQueryPool(_vk_logical_device, &queryPoolInfo, nullptr, &frame.timestamp_pool) != VK_SUCCESS) {
+      std::cerr << "Failed to create timestamp query pool" << std::endl;
+      return false;
+    }
+  }
+
+  CalibrateGpuClock();
+
+  return true;
+}
+
+void Renderer::CalibrateGpuClock() {
+  if (_gpu_calibrated_timestamps) {
+    VkCalibratedTimestampInfoEXT timestampInfos[2] = {};
+    timestampInfos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    timestampInfos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+    timestampInfos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    timestampInfos[1].timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+
+    uint64_t timestamps[2];
+    uint64_t maxDeviation;
+    if (_vkGetCalibratedTimestampsEXT(_vk_logical_device, 2, timestampInfos, timestamps, &maxDeviation) == VK_SUCCESS) {
+      // CLOCK_MONOTONIC is what steady_clock, and so Profiler::Now, reads on Linux
+      int64_t gpuNs = static_cast<int64_t>((timestamps[0] & _gpu_timestamp_mask) * _gpu_timestamp_period);
+      _gpu_clock_offset = static_cast<int64_t>(timestamps[1]) - gpuNs;
+      _gpu_last_calibration = Profiler::Now();
+      return;
+    }
+  }
+
+  // Without the extension write a timestamp and assume it landed halfway through the round trip
+  VkQueryPool pool = _frames.front().timestamp_pool;
+  VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
+  vkCmdResetQueryPool(commandBuffer, pool, 0, 1);
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool, 0);
+
+  int64_t cpuBefore = Profiler::Now();
   EndSingleTimeCommands(commandBuffer);
+  int64_t cpuAfter = Profiler::Now();
+
+  uint64_t timestamp = 0;
+  vkGetQueryPoolResults(_vk_logical_device, pool, 0, 1, sizeof(timestamp), &timestamp, sizeof(timestamp), 
+    VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+  int64_t gpuNs = static_cast<int64_t>((timestamp & _gpu_timestamp_mask) * _gpu_timestamp_period);
+  _gpu_clock_offset = (cpuBefore + cpuAfter) / 2 - gpuNs;
+  _gpu_last_calibration = cpuAfter;
+}
+
+uint32_t Renderer::BeginGpuZone(FrameResources& frame, VkCommandBuffer commandBuffer, const char* name) {
+  if (!frame.timestamps_active || frame.gpu_zones.size() >= MAX_GPU_ZONES) return UINT32_MAX;
+
+  uint32_t zone = static_cast<uint32_t>(frame.gpu_zones.size());
+  frame.gpu_zones.push_back(name);
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.timestamp_pool, zone * 2);
+
+  return zone;
+}
+
+void Renderer::EndGpuZone(FrameResources& frame, VkCommandBuffer commandBuffer, uint32_t zone) {
+  if (zone == UINT32_MAX) return;
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestamp_pool, zone * 2 + 1);
+}
+
+void Renderer::CollectGpuTimings(FrameResources& frame) {
+  if (frame.gpu_zones.empty()) return;
+
+  // The frame's fence has signaled so every query is available and this doesn't block
+  std::vector<uint64_t> timestamps(frame.gpu_zones.size() * 2);
+  VkResult result = vkGetQueryPoolResults(_vk_logical_device, frame.timestamp_pool, 0, static_cast<uint32_t>(timestamps.size()), 
+    timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+  if (result == VK_SUCCESS) {
+    for (size_t i = 0; i < frame.gpu_zones.size(); i++) {
+      int64_t start = static_cast<int64_t>((timestamps[i * 2] & _gpu_timestamp_mask) * _gpu_timestamp_period) + _gpu_clock_offset;
+      int64_t end = static_cast<int64_t>((timestamps[i * 2 + 1] & _gpu_timestamp_mask) * _gpu_timestamp_period) + _gpu_clock_offset;
+      Profiler::RecordGpu(frame.gpu_zones[i], start, end);
+    }
+  }
+
+  frame.gpu_zones.clear();
+
+  // The two clocks drift apart over time
+  if (_gpu_calibrated_timestamps && Profiler::Now() - _gpu_last_calibration > GPU_CALIBRATION_INTERVAL_NS)
+    CalibrateGpuClock();
+}
+
+void Renderer::DestroyCommandBuffers() {
+  for (auto& frame : _frames) {
+    // Destroying a pool frees the command buffers allocated from it
+    for (auto pool : frame.secondary_pools) {
+      vkDestroyCommandPool(_vk_logical_device, pool, nullptr);
+    }
+    vkDestroyCommandPool(_vk_logical_device, frame.command_pool, nullptr);
+    vkDestroyCommandPool(_vk_logical_device, frame.upload_pool, nullptr);
+    vkDestroyCommandPool(_vk_logical_device, frame.compute_pool, nullptr);
+    vkDestroySemaphore(_vk_logical_device, frame.compute_finished, nullptr);
+    vkDestroyQueryPool(_vk_logical_device, frame.timestamp_pool, nullptr);
+    DestroyDepthFramebuffers(frame);
+    if (frame.graph) frame.graph->Destroy();
+    if (frame.compute_graph) frame.compute_graph->Destroy();
+
+    DestroySpriteBuffer(frame);
+    DestroyCullBuffers(frame);
+    FreeRetiredBuffers(frame);
+  }
+
+  // Frees the cull descriptor sets with it
+  vkDestroyDescriptorPool(_vk_logical_device, _vk_cull_descriptor_pool, nullptr);
+  _vk_cull_descriptor_pool = VK_NULL_HANDLE;
+
+  _frames.clear();
+}
+
+bool Renderer::ReserveSpriteBuffer(FrameResources& frame, size_t sprite_count) {
+  if (sprite_count <= frame.sprite_capacity) return true;
+
+  size_t capacity = std::max(frame.sprite_capacity, MIN_SPRITE_CAPACITY);
+  while (capacity < sprite_count) capacity *= 2;
+
+  // Only called once this frame's fence has signaled so the old buffers are no longer in use
+  DestroySpriteBuffer(frame);
+
+  VkDeviceSize bufferSize = VertexSize(_vertex_format) * 4 * capacity;
+  if (!InitBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
+    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.sprite_buffer, frame.sprite_buffer_memory)) {
+    return false;
+  }
+
+  vkMapMemory(_vk_logical_device, frame.sprite_buffer_memory, 0, bufferSize, 0, &frame.sprite_vertices);
+  frame.sprite_capacity = capacity;
 
   return true;
 }
 
-bool Renderer::InitCommandBuffers() {
-  _vk_command_buffers.resize(_vk_swapchain_framebuffers.size());
+void Renderer::DestroySpriteBuffer(FrameResources& frame) {
+  if (frame.sprite_buffer != VK_NULL_HANDLE) {
+    vkUnmapMemory(_vk_logical_device, frame.sprite_buffer_memory);
+    vkDestroyBuffer(_vk_logical_device, frame.sprite_buffer, nullptr);
+    vkFreeMemory(_vk_logical_device, frame.sprite_buffer_memory, nullptr);
+    frame.sprite_buffer = VK_NULL_HANDLE;
+  }
 
-  VkCommandBufferAllocateInfo allocInfo = {};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.commandPool = _vk_command_pool;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandBufferCount = _vk_command_buffers.size();
+  frame.sprite_capacity = 0;
+}
+
+void Renderer::UpdateTilemap(FrameResources& frame, const std::shared_ptr<Tilemap>& tilemap, const Camera& camera) {
+  PROFILE_SCOPE("UpdateTilemap");
+
+  if (tilemap != _tilemap) {
+    for (auto& chunk : _chunk_buffers) {
+      RetireChunkBuffers(frame, chunk);
+    }
+
+    _tilemap = tilemap;
+    _chunk_buffers.clear();
+    if (_tilemap && _vertex_format == VertexFormat::Packed 
+      && _tilemap->TileSize() * Tilemap::CHUNK_SIZE > PackedVertex::POSITION_RANGE) {
+      std::cerr << "Tilemap chunks are larger than packed vertices can address, tiles will be clipped" << std::endl;
+    }
+    if (_tilemap) {
+      _chunk_buffers.resize(_tilemap->ChunkCount());
+      _tilemap->MarkAllDirty();
+    }
+  }
+
+  _visible_chunks.clear();
+  if (!_tilemap) return;
+
+  _tilemap->ApplyEdits();
+  if (!RebuildDirtyChunks(frame))
+    std::cerr << "Failed to rebuild tilemap chunks" << std::endl;
+
+  _tilemap->VisibleChunks(camera.position, camera.position + camera.size, _visible_chunks);
+}
+
+bool Renderer::RebuildDirtyChunks(FrameResources& frame) {
+  std::vector<Vertex> chunkVertices;
+  std::vector<PackedVertex> packedVertices;
+  VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+  bool ret = true;
+
+  for (uint32_t chunk = 0; chunk < _tilemap->ChunkCount(); chunk++) {
+    if (!_tilemap->ChunkDirty(chunk)) continue;
+
+    // The old buffers stay and the chunk stays dirty until the new ones are recorded, a failed
+    // rebuild is retried next frame
+    _tilemap->BuildChunkGeometry(chunk, chunkVertices);
+    if (chunkVertices.empty()) {
+      RetireChunkBuffers(frame, _chunk_buffers[chunk]);
+      _tilemap->ClearDirty(chunk);
+      continue;
+    }
+
+    ChunkBuffers buffers;
+    const void* vertexData = chunkVertices.data();
+    buffers.origin = _tilemap->ChunkOrigin(chunk);
+    if (_vertex_format == VertexFormat::Packed) {
+      packedVertices.clear();
+      for (const Vertex& v : chunkVertices) {
+        packedVertices.push_back(PackedVertex::Pack(v.pos, buffers.origin, v.color, v.texCoord, v.texture));
+      }
+      vertexData = packedVertices.data();
+    }
+
+    // Same staging path as InitVertexBuffer, but recorded into the frame's uploads. Staging buffers are
+    // freed once the frame's fence signals.
+    VkDeviceSize vertexSize = VertexSize(_vertex_format) * chunkVertices.size();
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    if (!InitBuffer(vertexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory)) {
+      ret = false;
+      break;
+    }
+    frame.retired_buffers.push_back({stagingBuffer, stagingBufferMemory});
+
+    void* data;
+    vkMapMemory(_vk_logical_device, stagingBufferMemory, 0, vertexSize, 0, &data);
+      memcpy(data, vertexData, static_cast<size_t>(vertexSize));
+    vkUnmapMemory(_vk_logical_device, stagingBufferMemory);
+
+    if (!InitBuffer(vertexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffers.vertex_buffer, buffers.vertex_buffer_memory)) {
+      ret = false;
+      break;
+    }
+
+    if (commandBuffer == VK_NULL_HANDLE)
+      commandBuffer = BeginFrameUploads(frame);
+
+    VkBufferCopy vertexRegion = {0, 0, vertexSize};
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, buffers.vertex_buffer, 1, &vertexRegion);
+
+    // Drawn with the shared quad indices, a chunk is well under MAX_QUADS_PER_DRAW
+    buffers.quad_count = static_cast<uint32_t>(chunkVertices.size() / 4);
 
-  if (vkAllocateCommandBuffers(_vk_logical_device, &allocInfo, _vk_command_buffers.data()) != VK_SUCCESS) {
-    std::cerr << "Failed to allocate vulkan command buffers" << std::endl;
+    RetireChunkBuffers(frame, _chunk_buffers[chunk]);
+    _chunk_buffers[chunk] = buffers;
+    _tilemap->ClearDirty(chunk);
+  }
+
+  if (commandBuffer != VK_NULL_HANDLE) {
+    // Make the copies visible to vertex input in this frame's draws and the ones after
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 
+      1, &barrier, 0, nullptr, 0, nullptr);
+  }
+
+  return ret;
+}
+
+void Renderer::RetireChunkBuffers(FrameResources& frame, ChunkBuffers& buffers) {
+  if (buffers.vertex_buffer != VK_NULL_HANDLE)
+    frame.retired_buffers.push_back({buffers.vertex_buffer, buffers.vertex_buffer_memory});
+
+  buffers = ChunkBuffers();
+}
+
+void Renderer::FreeRetiredBuffers(FrameResources& frame) {
+  for (auto& retired : frame.retired_buffers) {
+    vkDestroyBuffer(_vk_logical_device, retired.first, nullptr);
+    vkFreeMemory(_vk_logical_device, retired.second, nullptr);
+  }
+  frame.retired_buffers.clear();
+
+  // Nothing in flight samples the slot anymore, it points at the atlas until it's reused
+  for (uint32_t texture : frame.retired_textures) {
+    if (!_textures[texture].retired) continue; // already destroyed on shutdown
+    DestroyTexture(_textures[texture]);
+    if (!_vk_descriptor_sets.empty())
+      UpdateTextureDescriptors(texture);
+  }
+  frame.retired_textures.clear();
+}
+
+void Renderer::UpdateGpuSprites(FrameResources& frame, const std::shared_ptr<const std::vector<GpuSprite>>& sprites) {
+  PROFILE_SCOPE("UpdateGpuSprites");
+
+  frame.culled = false;
+  if (_compute_queue_family == -1)
+    return;
+
+  if (sprites != _gpu_sprites) {
+    // Frames still in flight may be culling the old set
+    if (_gpu_sprite_buffer != VK_NULL_HANDLE)
+      frame.retired_buffers.push_back({_gpu_sprite_buffer, _gpu_sprite_buffer_memory});
+
+    _gpu_sprites = sprites;
+    _gpu_sprite_buffer = VK_NULL_HANDLE;
+    _gpu_sprite_buffer_memory = VK_NULL_HANDLE;
+    _gpu_sprite_count = 0;
+    _gpu_sprite_generation++;
+
+    if (sprites && !sprites->empty()) {
+      VkDeviceSize bufferSize = sizeof(GpuSprite) * sprites->size();
+
+      VkBuffer stagingBuffer;
+      VkDeviceMemory stagingBufferMemory;
+      if (!InitBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory)) {
+        std::cerr << "Failed to upload GPU sprites" << std::endl;
+        return;
+      }
+
+      void* data;
+      vkMapMemory(_vk_logical_device, stagingBufferMemory, 0, bufferSize, 0, &data);
+        memcpy(data, sprites->data(), static_cast<size_t>(bufferSize));
+      vkUnmapMemory(_vk_logical_device, stagingBufferMemory);
+
+      if (InitBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _gpu_sprite_buffer, _gpu_sprite_buffer_memory, true)) {
+        CopyBuffer(stagingBuffer, _gpu_sprite_buffer, bufferSize);
+        _gpu_sprite_count = static_cast<uint32_t>(sprites->size());
+      } else {
+        std::cerr << "Failed to upload GPU sprites" << std::endl;
+      }
+
+      vkDestroyBuffer(_vk_logical_device, stagingBuffer, nullptr);
+      vkFreeMemory(_vk_logical_device, stagingBufferMemory, nullptr);
+    }
+  }
+
+  if (_gpu_sprite_count == 0)
+    return;
+
+  if (!ReserveCullBuffers(frame, _gpu_sprite_count)) {
+    std::cerr << "Failed to grow cull buffers" << std::endl;
+    return;
+  }
+
+  // Only this frame uses its set and its fence has signaled, so it can be rewritten in place
+  if (frame.cull_generation != _gpu_sprite_generation) {
+    std::array<VkDescriptorBufferInfo, 3> bufferInfos = {};
+    bufferInfos[0].buffer = _gpu_sprite_buffer;
+    bufferInfos[1].buffer = frame.cull_instance_buffer;
+    bufferInfos[2].buffer = frame.cull_indirect_buffer;
+
+    std::array<VkWriteDescriptorSet, 3> descriptorWrites = {};
+    for (uint32_t i = 0; i < descriptorWrites.size(); i++) {
+      bufferInfos[i].offset = 0;
+      bufferInfos[i].range = VK_WHOLE_SIZE;
+
+      descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      descriptorWrites[i].dstSet = frame.cull_descriptor_set;
+      descriptorWrites[i].dstBinding = i;
+      descriptorWrites[i].dstArrayElement = 0;
+      descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      descriptorWrites[i].descriptorCount = 1;
+      descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+    }
+
+    vkUpdateDescriptorSets(_vk_logical_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    frame.cull_generation = _gpu_sprite_generation;
+  }
+
+  frame.culled = true;
+}
+
+bool Renderer::ReserveCullBuffers(FrameResources& frame, size_t sprite_count) {
+  if (frame.cull_indirect_buffer == VK_NULL_HANDLE) {
+    if (!InitBuffer(sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | 
+      VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.cull_indirect_buffer, 
+      frame.cull_indirect_buffer_memory, true)) {
+      return false;
+    }
+  }
+
+  if (sprite_count <= frame.cull_capacity) return true;
+
+  size_t capacity = std::max(frame.cull_capacity, MIN_SPRITE_CAPACITY);
+  while (capacity < sprite_count) capacity *= 2;
+
+  // Only called once this frame's fence has signaled so the old buffer is no longer in use
+  if (frame.cull_instance_buffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(_vk_logical_device, frame.cull_instance_buffer, nullptr);
+    vkFreeMemory(_vk_logical_device, frame.cull_instance_buffer_memory, nullptr);
+    frame.cull_instance_buffer = VK_NULL_HANDLE;
+    frame.cull_capacity = 0;
+  }
+
+  // Sized for every sprite being visible, the shader never checks
+  if (!InitBuffer(sizeof(GpuSprite) * capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.cull_instance_buffer, frame.cull_instance_buffer_memory, true)) {
     return false;
   }
 
-  for (size_t i = 0; i < _vk_command_buffers.size(); i++) {
-    VkCommandBufferBeginInfo beginInfo = {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  frame.cull_capacity = capacity;
+  frame.cull_generation = 0; // the descriptor set still points at the old buffer
+
+  return true;
+}
+
+void Renderer::DestroyCullBuffers(FrameResources& frame) {
+  if (frame.cull_instance_buffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(_vk_logical_device, frame.cull_instance_buffer, nullptr);
+    vkFreeMemory(_vk_logical_device, frame.cull_instance_buffer_memory, nullptr);
+    frame.cull_instance_buffer = VK_NULL_HANDLE;
+  }
+
+  if (frame.cull_indirect_buffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(_vk_logical_device, frame.cull_indirect_buffer, nullptr);
+    vkFreeMemory(_vk_logical_device, frame.cull_indirect_buffer_memory, nullptr);
+    frame.cull_indirect_buffer = VK_NULL_HANDLE;
+  }
+
+  frame.cull_capacity = 0;
+  frame.cull_generation = 0;
+}
+
+void Renderer::AddCullPasses(RenderGraph& graph, FrameResources& frame, const Camera& camera, RenderResource instances, 
+  RenderResource indirect, bool timed) {
+  RenderResource sprites = graph.ImportBuffer("GPU Sprites", _gpu_sprite_buffer);
+
+  // One quad's indices and no instances yet, every surviving sprite bumps instanceCount
+  uint32_t reset = graph.AddPass("Cull Reset", [&](VkCommandBuffer commandBuffer) {
+    VkDrawIndexedIndirectCommand drawCommand = {};
+    drawCommand.indexCount = static_cast<uint32_t>(indices.size());
+    vkCmdUpdateBuffer(commandBuffer, frame.cull_indirect_buffer, 0, sizeof(drawCommand), &drawCommand);
+  });
+  graph.Write(reset, indirect, Access::TransferDst);
+
+  uint32_t cull = graph.AddPass("Cull", [&, timed](VkCommandBuffer commandBuffer) {
+    // Timestamps only go in the graphics command buffer, the query pool is reset there
+    uint32_t cullZone = timed ? BeginGpuZone(frame, commandBuffer, "Cull") : UINT32_MAX;
+
+    CullConstants constants = {};
+    constants.view = {camera.position.x, camera.position.y, camera.position.x + camera.size.x, camera.position.y + camera.size.y};
+    constants.count = _gpu_sprite_count;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _vk_cull_pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _vk_cull_pipeline_layout, 0, 1, &frame.cull_descriptor_set, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, _vk_cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(commandBuffer, (_gpu_sprite_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    EndGpuZone(frame, commandBuffer, cullZone);
+  });
+  graph.Read(cull, sprites, Access::StorageRead);
+  graph.Write(cull, instances, Access::StorageWrite);
+  graph.Write(cull, indirect, Access::StorageWrite);
+}
 
-    if (vkBeginCommandBuffer(_vk_command_buffers[i], &beginInfo) != VK_SUCCESS) {
-      std::cerr << "Failed to begin recording vulkan command buffer" << std::endl;
+bool Renderer::SubmitCull(FrameResources& frame, const Camera& camera) {
+  PROFILE_SCOPE("SubmitCull");
+
+  vkResetCommandPool(_vk_logical_device, frame.compute_pool, 0);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(frame.compute_buffer, &beginInfo) != VK_SUCCESS) {
+    std::cerr << "Failed to begin recording vulkan command buffer" << std::endl;
+    return false;
+  }
+
+  // Nothing reads the results in this graph, the semaphore the graphics submit waits on makes them visible
+  RenderGraph& graph = *frame.compute_graph;
+  graph.Reset();
+  AddCullPasses(graph, frame, camera, graph.ImportBuffer("Cull Instances", frame.cull_instance_buffer), 
+    graph.ImportBuffer("Cull Indirect", frame.cull_indirect_buffer), false);
+  if (!graph.Compile()) return false;
+  graph.Execute(frame.compute_buffer);
+
+  if (vkEndCommandBuffer(frame.compute_buffer) != VK_SUCCESS) {
+    std::cerr << "Failed to record vulkan command buffer" << std::endl;
+    return false;
+  }
+
+  // No fence, the graphics submit waits on the semaphore so the frame's fence covers this work too
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &frame.compute_buffer;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores = &frame.compute_finished;
+
+  if (vkQueueSubmit(_vk_compute_queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+    std::cerr << "Failed to submit cull command buffer" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+void Renderer::BuildRenderQueue(const std::vector<Sprite>& sprites) {
+  PROFILE_SCOPE("BuildRenderQueue");
+
+  _render_queue.Clear();
+  _render_queue.Reserve(sprites.size());
+
+  // Sprites name texture pages, pages that aren't resident yet draw with the placeholder
+  _texture_manager.Resolve(sprites, _sprite_textures);
+
+  // With bindless textures the texture is picked per vertex, so only the layer tells sprites apart.
+  // Otherwise each texture is its own descriptor set and sprites are grouped by it within a layer.
+  for (size_t i = 0; i < sprites.size(); i++) {
+    uint32_t texture = _bindless ? 0 : _sprite_textures[i];
+    if (_depth_layering) {
+      bool opaque = sprites[i].opaque;
+      _render_queue.Push(RenderQueue::MakeKey(DepthSortLayer(sprites[i].layer, opaque), opaque ? _opaque_pipeline : _translucent_pipeline, 
+        texture), static_cast<uint32_t>(i));
+    } else {
+      _render_queue.Push(RenderQueue::MakeKey(sprites[i].layer, _stream_pipeline, texture), static_cast<uint32_t>(i));
     }
+  }
+
+  // Each layer is drawn at its own depth, so with depth layering a batch can't span layers
+  _render_queue.Sort(&_workers);
+  _render_queue.BuildBatches(_depth_layering);
+}
+
+void Renderer::WriteSpriteVertices(FrameResources& frame, const std::vector<Sprite>& sprites, float alpha) {
+  PROFILE_SCOPE("WriteSpriteVertices");
+
+  const std::vector<DrawPacket>& packets = _render_queue.Packets();
+  if (packets.empty()) return;
+
+  size_t jobCount = std::clamp<size_t>(packets.size() / MIN_SPRITES_PER_JOB, 1, _workers.Concurrency());
+  size_t perJob = (packets.size() + jobCount - 1) / jobCount;
+
+  // Quads land in the buffer in sorted order, each job owns a slice so nothing is shared. Indices come
+  // from the shared quad index buffer, so there is nothing else to write.
+  auto writeJob = [&](unsigned job) {
+    size_t first = job * perJob;
+    size_t last = std::min(first + perJob, packets.size());
+
+    Vertex* out = static_cast<Vertex*>(frame.sprite_vertices) + first * 4;
+    PackedVertex* packedOut = static_cast<PackedVertex*>(frame.sprite_vertices) + first * 4;
+
+    for (size_t i = first; i < last; i++) {
+      const Sprite& s = sprites[packets[i].index];
+      glm::vec2 pos = glm::mix(s.prev_pos, s.pos, alpha);
+      uint32_t texture = _sprite_textures[packets[i].index];
+
+      if (_vertex_format == VertexFormat::Packed) {
+        glm::vec2 origin = frame.sprite_origin;
+        *packedOut++ = PackedVertex::Pack({pos.x, pos.y}, origin, s.color, {s.uv.x, s.uv.y}, texture);
+        *packedOut++ = PackedVertex::Pack({pos.x + s.size.x, pos.y}, origin, s.color, {s.uv.x + s.uv.z, s.uv.y}, texture);
+        *packedOut++ = PackedVertex::Pack({pos.x + s.size.x, pos.y + s.size.y}, origin, s.color, {s.uv.x + s.uv.z, s.uv.y + s.uv.w}, texture);
+        *packedOut++ = PackedVertex::Pack({pos.x, pos.y + s.size.y}, origin, s.color, {s.uv.x, s.uv.y + s.uv.w}, texture);
+      } else {
+        *out++ = {{pos.x, pos.y}, s.color, {s.uv.x, s.uv.y}, texture};
+        *out++ = {{pos.x + s.size.x, pos.y}, s.color, {s.uv.x + s.uv.z, s.uv.y}, texture};
+        *out++ = {{pos.x + s.size.x, pos.y + s.size.y}, s.color, {s.uv.x + s.uv.z, s.uv.y + s.uv.w}, texture};
+        *out++ = {{pos.x, pos.y + s.size.y}, s.color, {s.uv.x, s.uv.y + s.uv.w}, texture};
+      }
+    }
+  };
+
+  if (jobCount > 1) _workers.Dispatch(static_cast<unsigned>(jobCount), writeJob);
+  else writeJob(0);
+}
+
+void Renderer::RecordCommandBuffer(FrameResources& frame, uint32_t imageIndex, const std::vector<Sprite>& sprites, float alpha, 
+  const Camera& camera) {
+  vkResetCommandPool(_vk_logical_device, frame.command_pool, 0);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(frame.command_buffer, &beginInfo) != VK_SUCCESS) {
+    std::cerr << "Failed to begin recording vulkan command buffer" << std::endl;
+  }
+
+  // Latch the profiler state so a toggle mid-recording can't write into a pool we didn't reset
+  frame.timestamps_active = _gpu_timestamps && Profiler::Enabled();
+  if (frame.timestamps_active)
+    vkCmdResetQueryPool(frame.command_buffer, frame.timestamp_pool, 0, MAX_GPU_ZONES * 2);
+
+  // Packed sprites are stored relative to the camera, which keeps them in range of PackedVertex
+  frame.sprite_origin = camera.position;
+  BuildRenderQueue(sprites);
+  WriteSpriteVertices(frame, sprites, alpha);
+
+  // Windowed frames draw into an image the submit waits to acquire and hand it to present, offscreen
+  // targets are only ever read back
+  RenderGraph& graph = *frame.graph;
+  graph.Reset();
+  Access targetInitial = _headless ? Access::None : Access::Acquired;
+  Access targetFinal = _headless ? Access::TransferSrc : Access::Present;
+  RenderResource target = graph.ImportImage("Swapchain", _vk_swapchain_images[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT, 
+    targetInitial, targetFinal);
+
+  RenderResource instances = 0;
+  RenderResource indirect = 0;
+  if (frame.culled) {
+    instances = graph.ImportBuffer("Cull Instances", frame.cull_instance_buffer);
+    indirect = graph.ImportBuffer("Cull Indirect", frame.cull_indirect_buffer);
+    if (!_separate_compute) AddCullPasses(graph, frame, camera, instances, indirect, true);
+  }
+
+  // One per frame in flight since every graph keeps its own transient images
+  RenderResource depth = 0;
+  if (_depth_layering) {
+    TransientImageDesc depthDesc;
+    depthDesc.width = _vk_swapchain_extent.width;
+    depthDesc.height = _vk_swapchain_extent.height;
+    depthDesc.format = DEPTH_FORMAT;
+    depthDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    depthDesc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    depth = graph.CreateImage("Depth", depthDesc);
+  }
+
+  uint32_t mainPass = graph.AddPass("Main Pass", [&](VkCommandBuffer commandBuffer) {
+    VkFramebuffer framebuffer = GetFramebuffer(frame, imageIndex, _depth_layering ? graph.GetImageView(depth) : VK_NULL_HANDLE);
+    if (framebuffer == VK_NULL_HANDLE) return;
+
+    uint32_t mainPassZone = BeginGpuZone(frame, commandBuffer, "Main Pass");
+
+    const std::vector<DrawBatch>& batches = _render_queue.Batches();
+    size_t jobCount = std::min(batches.size() / MIN_BATCHES_PER_JOB, frame.secondary_buffers.size());
 
     VkRenderPassBeginInfo renderPassInfo = {};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     renderPassInfo.renderPass = _vk_render_pass;
-    renderPassInfo.framebuffer = _vk_swapchain_framebuffers[i];
+    renderPassInfo.framebuffer = framebuffer;
     renderPassInfo.renderArea.offset = {0, 0};
     renderPassInfo.renderArea.extent = _vk_swapchain_extent;
 
-    VkClearValue clearColor = {1.0f, 1.0f, 1.0f, 1.0f};
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
+    std::array<VkClearValue, 2> clearValues = {};
+    clearValues[0].color = {{1.0f, 1.0f, 1.0f, 1.0f}};
+    clearValues[1].depthStencil = {1.0f, 0};
+    renderPassInfo.clearValueCount = (_depth_layering) ? 2 : 1;
+    renderPassInfo.pClearValues = clearValues.data();
+
+    if (jobCount <= 1) {
+      vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        RecordDraws(commandBuffer, frame, imageIndex, 0, batches.size(), true);
+      vkCmdEndRenderPass(commandBuffer);
+    } else {
+      vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+      size_t perJob = (batches.size() + jobCount - 1) / jobCount;
+
+      // Each job owns a pool and a slice of the batches, so they can record without locking
+      _workers.Dispatch(static_cast<unsigned>(jobCount), [&](unsigned job) {
+        PROFILE_SCOPE("RecordSecondary");
+
+        VkCommandBuffer secondaryBuffer = frame.secondary_buffers[job];
+        vkResetCommandPool(_vk_logical_device, frame.secondary_pools[job], 0);
+
+        VkCommandBufferInheritanceInfo inheritanceInfo = {};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = _vk_render_pass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = framebuffer;
+
+        VkCommandBufferBeginInfo secondaryBeginInfo = {};
+        secondaryBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        secondaryBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        secondaryBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+        if (vkBeginCommandBuffer(secondaryBuffer, &secondaryBeginInfo) != VK_SUCCESS) {
+          std::cerr << "Failed to begin recording vulkan command buffer" << std::endl;
+        }
+
+        size_t first = job * perJob;
+        size_t count = std::min(perJob, batches.size() - first);
+        RecordDraws(secondaryBuffer, frame, imageIndex, first, count, job == 0);
+
+        if (vkEndCommandBuffer(secondaryBuffer) != VK_SUCCESS) {
+          std::cerr << "Failed to record vulkan command buffer" << std::endl;
+        }
+      });
+
+      vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(jobCount), frame.secondary_buffers.data());
+      vkCmdEndRenderPass(commandBuffer);
+    }
 
-    vkCmdBeginRenderPass(_vk_command_buffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    EndGpuZone(frame, commandBuffer, mainPassZone);
+  });
+  graph.Write(mainPass, target, Access::ColorAttachment);
+  if (_depth_layering) graph.Write(mainPass, depth, Access::DepthAttachment);
+  if (frame.culled) {
+    graph.Read(mainPass, indirect, Access::IndirectRead);
+    graph.Read(mainPass, instances, Access::VertexRead);
+  }
+
+  // Nothing is drawn, but the image still has to end up where present or the readback expect it
+  if (graph.Compile()) {
+    graph.Execute(frame.command_buffer);
+  } else {
+    std::cerr << "Failed to compile the frame's render graph" << std::endl;
+    RenderGraph::RecordTransition(frame.command_buffer, _vk_swapchain_images[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT, 
+      targetInitial, targetFinal);
+  }
+
+  if (vkEndCommandBuffer(frame.command_buffer) != VK_SUCCESS) {
+    std::cerr << "Failed to record vulkan command buffer" << std::endl;
+  }
+}
+
+void Renderer::RecordDraws(VkCommandBuffer commandBuffer, FrameResources& frame, uint32_t imageIndex, size_t firstBatch, size_t batchCount, 
+  bool drawStatic) {
+  // Pipelines that are still being created come back null, whatever uses them is skipped this frame
+  VkPipeline boundPipeline = VK_NULL_HANDLE;
+  auto bindPipeline = [&](VkPipeline pipeline) {
+    if (pipeline != boundPipeline)
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    boundPipeline = pipeline;
+  };
+
+  VkViewport viewport = {};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = static_cast<float>(_vk_swapchain_extent.width);
+  viewport.height = static_cast<float>(_vk_swapchain_extent.height);
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  VkRect2D scissor = {};
+  scissor.offset = {0, 0};
+  scissor.extent = _vk_swapchain_extent;
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-        vkCmdBindPipeline(_vk_command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _vk_graphics_pipeline);
+  // Tiles and GPU sprites sample the atlas unless the textures are bindless
+  VkDescriptorSet descriptorSet = GetDescriptorSet(imageIndex, 0);
+  uint32_t boundTexture = 0;
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _vk_pipeline_layout, 0, 1, &descriptorSet, 0, nullptr);
 
-          VkBuffer vertexBuffers[] = {_vk_vertex_buffer};
-          VkDeviceSize offsets[] = {0};
-          vkCmdBindVertexBuffers(_vk_command_buffers[i], 0, 1, vertexBuffers, offsets);
+  VkDeviceSize offsets[] = {0};
 
-          vkCmdBindIndexBuffer(_vk_command_buffers[i], _vk_index_buffer, 0, VK_INDEX_TYPE_UINT16);
+  // Everything is drawn as quads, so one index buffer serves every draw
+  vkCmdBindIndexBuffer(commandBuffer, _vk_index_buffer, 0, VK_INDEX_TYPE_UINT16);
 
-          vkCmdBindDescriptorSets(_vk_command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _vk_pipeline_layout, 0, 1, &_vk_descriptor_sets[i], 0, nullptr);
+  if (drawStatic) {
+    VkPipeline spritePipeline = _pipelines.Get(_sprite_pipeline);
+    if (spritePipeline != VK_NULL_HANDLE) {
+      bindPipeline(spritePipeline);
+      vkCmdBindVertexBuffers(commandBuffer, 0, 1, &_vk_vertex_buffer, offsets);
+      vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+    }
 
-          vkCmdDrawIndexed(_vk_command_buffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+    // Tiles go between the background and the sprites, in the same format as the sprites
+    VkPipeline streamPipeline = _pipelines.Get(_stream_pipeline);
+    if (streamPipeline != VK_NULL_HANDLE) {
+      bindPipeline(streamPipeline);
 
-    vkCmdEndRenderPass(_vk_command_buffers[i]);
+      for (uint32_t chunk : _visible_chunks) {
+        const ChunkBuffers& buffers = _chunk_buffers[chunk];
+        if (buffers.quad_count == 0) continue;
 
-    if (vkEndCommandBuffer(_vk_command_buffers[i]) != VK_SUCCESS) {
-      std::cerr << "Failed to record vulkan command buffer" << std::endl;
-      return false;
+        vkCmdPushConstants(commandBuffer, _vk_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(buffers.origin), &buffers.origin);
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffers.vertex_buffer, offsets);
+        vkCmdDrawIndexed(commandBuffer, buffers.quad_count * 6, 1, 0, 0, 0);
+      }
+    }
+
+    // GPU sprites between the tiles and the sprites, the instance count comes from the cull pass
+    VkPipeline instancedPipeline = _pipelines.Get(_instanced_pipeline);
+    if (frame.culled && instancedPipeline != VK_NULL_HANDLE) {
+      bindPipeline(instancedPipeline);
+      vkCmdBindVertexBuffers(commandBuffer, 0, 1, &frame.cull_instance_buffer, offsets);
+      vkCmdDrawIndexedIndirect(commandBuffer, frame.cull_indirect_buffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
     }
   }
 
-  return true;
+  if (batchCount == 0) return;
+
+  vkCmdPushConstants(commandBuffer, _vk_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(frame.sprite_origin), &frame.sprite_origin);
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, &frame.sprite_buffer, offsets);
+
+  // Pipelines are PipelineManager ids. Texture ids only differ between batches without bindless textures.
+  const std::vector<DrawBatch>& batches = _render_queue.Batches();
+  uint32_t boundLayer = UINT32_MAX;
+  for (size_t i = firstBatch; i < firstBatch + batchCount; i++) {
+    const DrawBatch& batch = batches[i];
+
+    VkPipeline pipeline = _pipelines.Get(batch.pipeline);
+    if (pipeline == VK_NULL_HANDLE) continue;
+    bindPipeline(pipeline);
+
+    // A depth range of a single value puts the whole batch at its layer's depth
+    if (_depth_layering && batch.layer != boundLayer) {
+      viewport.minDepth = LayerDepth(batch.layer);
+      viewport.maxDepth = viewport.minDepth;
+      vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+      boundLayer = batch.layer;
+    }
+
+    if (batch.texture != boundTexture) {
+      descriptorSet = GetDescriptorSet(imageIndex, batch.texture);
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _vk_pipeline_layout, 0, 1, &descriptorSet, 0, nullptr);
+      boundTexture = batch.texture;
+    }
+
+    // vertexOffset moves the shared indices onto the batch, runs past what UINT16 reaches are split
+    for (uint32_t drawn = 0; drawn < batch.count; drawn += MAX_QUADS_PER_DRAW) {
+      uint32_t quads = std::min(batch.count - drawn, MAX_QUADS_PER_DRAW);
+      vkCmdDrawIndexed(commandBuffer, quads * 6, 1, 0, static_cast<int32_t>((batch.first + drawn) * 4), 0);
+    }
+  }
 }
 
 bool Renderer::InitSyncObjects() {
-  _vk_image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  _vk_render_finished_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  _vk_in_flight_fences.resize(MAX_FRAMES_IN_FLIGHT);
+  size_t frameCount = GetLatencyPolicy(_latency_mode).frames_in_flight;
+  _vk_image_available_semaphores.resize(frameCount);
+  _vk_render_finished_semaphores.resize(frameCount);
+  _vk_in_flight_fences.resize(frameCount);
 
   VkSemaphoreCreateInfo semaphoreInfo = {};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -997,7 +2367,7 @@ bool Renderer::InitSyncObjects() {
   fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
   fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < frameCount; i++) {
     if (vkCreateSemaphore(_vk_logical_device, &semaphoreInfo, nullptr, &_vk_image_available_semaphores[i]) != VK_SUCCESS ||
       vkCreateSemaphore(_vk_logical_device, &semaphoreInfo, nullptr, &_vk_render_finished_semaphores[i]) != VK_SUCCESS ||
       vkCreateFence(_vk_logical_device, &fenceInfo, nullptr, &_vk_in_flight_fences[i]) != VK_SUCCESS) {
@@ -1009,6 +2379,17 @@ bool Renderer::InitSyncObjects() {
   return true;
 }
 
+void Renderer::DestroySyncObjects() {
+  for (size_t i = 0; i < _vk_in_flight_fences.size(); i++) {
+    vkDestroySemaphore(_vk_logical_device, _vk_render_finished_semaphores[i], nullptr);
+    vkDestroySemaphore(_vk_logical_device, _vk_image_available_semaphores[i], nullptr);
+    vkDestroyFence(_vk_logical_device, _vk_in_flight_fences[i], nullptr);
+  }
+  _vk_render_finished_semaphores.clear();
+  _vk_image_available_semaphores.clear();
+  _vk_in_flight_fences.clear();
+}
+
 bool Renderer::InitVertexBuffer() {
   VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
 
@@ -1038,13 +2419,22 @@ bool Renderer::InitVertexBuffer() {
 }
 
 bool Renderer::InitBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, 
-  VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+  VkBuffer& buffer, VkDeviceMemory& bufferMemory, bool shareWithCompute) {
   VkBufferCreateInfo bufferInfo = {};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
   bufferInfo.usage = usage;
   bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+  // Saves queue family ownership transfers, the semaphores between the submits already order the accesses
+  uint32_t queueFamilies[] = {static_cast<uint32_t>(_device_manager.GetOperationQueueIndex(VK_QUEUE_GRAPHICS_BIT)), 
+    static_cast<uint32_t>(_compute_queue_family)};
+  if (shareWithCompute && _separate_compute) {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = 2;
+    bufferInfo.pQueueFamilyIndices = queueFamilies;
+  }
+
   if (vkCreateBuffer(_vk_logical_device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
     std::cerr << "Failed to create buffer" << std::endl;
     return false;
@@ -1056,7 +2446,8 @@ bool Renderer::InitBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryP
   VkMemoryAllocateInfo allocInfo = {};
   allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
   allocInfo.allocationSize = memRequirements.size;
-  if (int idx = _device_manager.GetCurrentDevice()->GetMemoryTypeIndex(memRequirements.memoryTypeBits, properties) >= 0) {
+  int idx = _device_manager.GetCurrentDevice()->GetMemoryTypeIndex(memRequirements.memoryTypeBits, properties);
+  if (idx >= 0) {
     allocInfo.memoryTypeIndex = idx;
   } else {
     std::cerr << "Failed to find suitable memory type" << std::endl;
@@ -1084,9 +2475,7 @@ void Renderer::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize s
   EndSingleTimeCommands(commandBuffer);
 }
 
-void Renderer::CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-  VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
-
+void Renderer::CopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
   VkBufferImageCopy region = {};
   region.bufferOffset = 0;
   region.bufferRowLength = 0;
@@ -1103,12 +2492,18 @@ void Renderer::CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width,
   };
 
   vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-  EndSingleTimeCommands(commandBuffer);
 }
 
 bool Renderer::InitIndexBuffer() {
-  VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+  std::vector<uint16_t> quadIndices;
+  quadIndices.reserve(MAX_QUADS_PER_DRAW * indices.size());
+  for (uint32_t quad = 0; quad < MAX_QUADS_PER_DRAW; quad++) {
+    for (uint16_t index : indices) {
+      quadIndices.push_back(static_cast<uint16_t>(quad * 4 + index));
+    }
+  }
+
+  VkDeviceSize bufferSize = sizeof(quadIndices[0]) * quadIndices.size();
 
   VkBuffer stagingBuffer;
   VkDeviceMemory stagingBufferMemory;
@@ -1116,7 +2511,7 @@ bool Renderer::InitIndexBuffer() {
 
   void* data;
   vkMapMemory(_vk_logical_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, indices.data(), (size_t) bufferSize);
+  memcpy(data, quadIndices.data(), (size_t) bufferSize);
   vkUnmapMemory(_vk_logical_device, stagingBufferMemory);
 
   InitBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, 
@@ -1131,6 +2526,8 @@ bool Renderer::InitIndexBuffer() {
 }
 
 const std::vector<const char*> Renderer::GetRequiredExtensions() const {
+  // Swapchains are the only thing we need an extension for
+  if (_headless) return {};
   return _vk_required_extenstions;
 }
 
@@ -1148,11 +2545,10 @@ bool Renderer::InitUniformBuffers() {
   return true;
 }
 
-void Renderer::UpdateUniformBuffer(uint32_t currentImage) {
+void Renderer::UpdateUniformBuffer(uint32_t currentImage, const Camera& camera) {
   UniformBufferObject ubo = {};
-  float camera_x = 0, camera_y = 0;
-  ubo.view = glm::translate(glm::mat4(1.0), glm::vec3(camera_x, camera_y, 0.0f));
-  ubo.proj = glm::ortho(0.0f, 1280.f, 0.0f, 720.f, -1.0f, 1.0f);
+  ubo.view = glm::translate(glm::mat4(1.0), glm::vec3(-camera.position, 0.0f));
+  ubo.proj = glm::ortho(0.0f, camera.size.x, 0.0f, camera.size.y, -1.0f, 1.0f);
 
   void* data;
   vkMapMemory(_vk_logical_device, _vk_uniform_buffers_memory[currentImage], 0, sizeof(ubo), 0, &data);
@@ -1160,36 +2556,105 @@ void Renderer::UpdateUniformBuffer(uint32_t currentImage) {
   vkUnmapMemory(_vk_logical_device, _vk_uniform_buffers_memory[currentImage]);
 }
 
-void Renderer::DrawFrame() {
-  vkWaitForFences(_vk_logical_device, 1, &_vk_in_flight_fences[_current_frame], VK_TRUE, UINT64_MAX);
+void Renderer::DrawFrame(const FrameSnapshot& snapshot) {
+  PROFILE_SCOPE("DrawFrame");
+  const std::vector<Sprite>& sprites = snapshot.sprites;
 
-  uint32_t imageIndex;
-  VkResult result = vkAcquireNextImageKHR(_vk_logical_device, _vk_swapchain, UINT64_MAX, 
-    _vk_image_available_semaphores[_current_frame], VK_NULL_HANDLE, &imageIndex);
+  {
+    PROFILE_SCOPE("WaitForFence");
+    auto waitStart = std::chrono::steady_clock::now();
+    vkWaitForFences(_vk_logical_device, 1, &_vk_in_flight_fences[_current_frame], VK_TRUE, UINT64_MAX);
+    _frame_stats.Record(FrameMetric::FenceWait, ElapsedMs(waitStart));
+  }
 
-  if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-    ResetSwapChain();
+  FrameResources& frame = _frames[_current_frame];
+  FreeRetiredBuffers(frame);
+  CollectGpuTimings(frame);
+
+  if (!ReserveSpriteBuffer(frame, sprites.size())) {
+    std::cerr << "Failed to grow sprite buffer" << std::endl;
     return;
-  } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-    std::cerr << "Failed to acquire swap chain image" << std::endl;
   }
 
-  UpdateUniformBuffer(imageIndex);
+  uint32_t imageIndex;
+  VkResult result;
+  if (_headless) {
+    // Offscreen targets are paired with frames in flight, so there is nothing to acquire
+    imageIndex = static_cast<uint32_t>(_current_frame);
+  } else {
+    PROFILE_SCOPE("Acquire");
+    auto acquireStart = std::chrono::steady_clock::now();
+    result = vkAcquireNextImageKHR(_vk_logical_device, _vk_swapchain, UINT64_MAX, 
+      _vk_image_available_semaphores[_current_frame], VK_NULL_HANDLE, &imageIndex);
+    _frame_stats.Record(FrameMetric::Acquire, ElapsedMs(acquireStart));
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+      ResetSwapChain();
+      return;
+    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+      std::cerr << "Failed to acquire swap chain image" << std::endl;
+    }
+  }
+
+  // Nothing returns early from here to the submit, texture uploads and releases made now go with this frame
+  _preparing_frame = &frame;
+  _asset_loader.RunCompletions();
+  _texture_manager.Update();
+
+  // The snapshot's state is shown one tick late so there is always a newer state to blend towards
+  float alpha = 1.0f;
+  if (snapshot.tick_length > 0)
+    alpha = std::clamp(static_cast<float>(TickClockNow() - snapshot.tick_time) / snapshot.tick_length, 0.0f, 1.0f);
+
+  Camera camera = snapshot.camera;
+  camera.position = glm::mix(snapshot.previous_camera.position, snapshot.camera.position, alpha);
+  camera.size = glm::mix(snapshot.previous_camera.size, snapshot.camera.size, alpha);
+  UpdateUniformBuffer(imageIndex, camera);
+  UpdateTilemap(frame, snapshot.tilemap, camera);
+  UpdateGpuSprites(frame, snapshot.gpu_sprites);
+
+  if (frame.culled && _separate_compute)
+    frame.culled = SubmitCull(frame, camera);
+
+  {
+    PROFILE_SCOPE("Record");
+    RecordCommandBuffer(frame, imageIndex, sprites, alpha, camera);
+  }
 
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-  VkSemaphore waitSemaphores[] = {_vk_image_available_semaphores[_current_frame]};
-  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
+  // The image is only needed once color is written, the cull results once the indirect draw is read
+  VkSemaphore waitSemaphores[2];
+  VkPipelineStageFlags waitStages[2];
+  uint32_t waitCount = 0;
+  if (!_headless) {
+    waitSemaphores[waitCount] = _vk_image_available_semaphores[_current_frame];
+    waitStages[waitCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  }
+  if (frame.culled && _separate_compute) {
+    waitSemaphores[waitCount] = frame.compute_finished;
+    waitStages[waitCount++] = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+  }
+  submitInfo.waitSemaphoreCount = waitCount;
   submitInfo.pWaitSemaphores = waitSemaphores;
   submitInfo.pWaitDstStageMask = waitStages;
 
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &_vk_command_buffers[imageIndex];
+  // Uploads go first, their barriers make the textures visible to the draws
+  VkCommandBuffer commandBuffers[2];
+  uint32_t commandBufferCount = 0;
+  if (frame.uploads_recorded) {
+    vkEndCommandBuffer(frame.upload_buffer);
+    commandBuffers[commandBufferCount++] = frame.upload_buffer;
+    frame.uploads_recorded = false;
+  }
+  commandBuffers[commandBufferCount++] = frame.command_buffer;
+
+  submitInfo.commandBufferCount = commandBufferCount;
+  submitInfo.pCommandBuffers = commandBuffers;
 
   VkSemaphore signalSemaphores[] = {_vk_render_finished_semaphores[_current_frame]};
-  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.signalSemaphoreCount = (_headless) ? 0 : 1;
   submitInfo.pSignalSemaphores = signalSemaphores;
 
   vkResetFences(_vk_logical_device, 1, &_vk_in_flight_fences[_current_frame]);
@@ -1197,6 +2662,14 @@ void Renderer::DrawFrame() {
   if (vkQueueSubmit(_vk_graphics_queue, 1, &submitInfo, _vk_in_flight_fences[_current_frame]) != VK_SUCCESS) {
     std::cerr << "Failed to submit draw command buffer" << std::endl;
   }
+  _preparing_frame = nullptr;
+
+  _last_frame = _current_frame;
+
+  if (_headless) {
+    _current_frame = (_current_frame + 1) % _frames.size();
+    return;
+  }
 
   VkPresentInfoKHR presentInfo = {};
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1210,16 +2683,158 @@ void Renderer::DrawFrame() {
 
   presentInfo.pImageIndices = &imageIndex;
 
-  result = vkQueuePresentKHR(_vk_present_queue, &presentInfo);
+  {
+    PROFILE_SCOPE("Present");
+    auto presentStart = std::chrono::steady_clock::now();
+    result = vkQueuePresentKHR(_vk_present_queue, &presentInfo);
+    _frame_stats.Record(FrameMetric::Present, ElapsedMs(presentStart));
+  }
 
-  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebuffer_resized) {
-    framebuffer_resized = false;
+  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || _framebuffer_resized.exchange(false)) {
     ResetSwapChain();
   } else if (result != VK_SUCCESS) {
     std::cerr << "Failed to present swap chain image" << std::endl;
   }
 
-  _current_frame = (_current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+  _current_frame = (_current_frame + 1) % _frames.size();
+}
+
+void Renderer::NotifyFramebufferResized(int width, int height) {
+  _framebuffer_width = width;
+  _framebuffer_height = height;
+  _framebuffer_resized = true;
+}
+
+FrameStats& Renderer::GetFrameStats() {
+  return _frame_stats;
+}
+
+TextureManager& Renderer::GetTextureManager() {
+  return _texture_manager;
+}
+
+AssetLoader& Renderer::GetAssetLoader() {
+  return _asset_loader;
+}
+
+bool Renderer::SetLatencyMode(LatencyMode mode) {
+  if (mode == _latency_mode)
+    return true;
+
+  _latency_mode = mode;
+
+  // Not initialized yet, the Init* functions pick the policy up
+  if (_frames.empty())
+    return true;
+
+  vkWaitForFences(_vk_logical_device, static_cast<uint32_t>(_vk_in_flight_fences.size()), _vk_in_flight_fences.data(), 
+    VK_TRUE, UINT64_MAX);
+
+  if (GetLatencyPolicy(mode).frames_in_flight != _frames.size()) {
+    DestroySyncObjects();
+    DestroyCommandBuffers();
+    _current_frame = 0;
+    _last_frame = 0;
+
+    if (!InitCommandBuffers() || !InitSyncObjects()) {
+      std::cerr << "Failed to resize frame resources" << std::endl;
+      return false;
+    }
+  }
+
+  // Goes through oldSwapchain like a resize, the pipeline survives since the format doesn't change
+  return ResetSwapChain();
+}
+
+LatencyMode Renderer::GetLatencyMode() const {
+  return _latency_mode;
+}
+
+bool Renderer::SetVertexFormat(VertexFormat format) {
+  if (!_frames.empty()) {
+    std::cerr << "Vertex format can only be changed before the renderer is initialized" << std::endl;
+    return false;
+  }
+
+  _vertex_format = format;
+  return true;
+}
+
+VertexFormat Renderer::GetVertexFormat() const {
+  return _vertex_format;
+}
+
+bool Renderer::SetDepthLayering(bool enabled) {
+  if (!_frames.empty()) {
+    std::cerr << "Depth layering can only be changed before the renderer is initialized" << std::endl;
+    return false;
+  }
+
+  _depth_layering = enabled;
+  return true;
+}
+
+bool Renderer::DepthLayering() const {
+  return _depth_layering;
+}
+
+const char* Renderer::LatencyModeName(LatencyMode mode) {
+  switch (mode) {
+    case LatencyMode::LowLatency: return "Low latency";
+    case LatencyMode::VSync: return "VSync";
+    case LatencyMode::Throughput: return "Throughput";
+  }
+  return "Unknown";
+}
+
+bool Renderer::SaveFrame(const char* path) {
+  if (!_headless) {
+    std::cerr << "Frame readback is only supported in headless mode" << std::endl;
+    return false;
+  }
+
+  vkWaitForFences(_vk_logical_device, 1, &_vk_in_flight_fences[_last_frame], VK_TRUE, UINT64_MAX);
+
+  uint32_t width = _vk_swapchain_extent.width;
+  uint32_t height = _vk_swapchain_extent.height;
+  VkDeviceSize imageSize = static_cast<VkDeviceSize>(width) * height * 4;
+
+  VkBuffer readbackBuffer;
+  VkDeviceMemory readbackBufferMemory;
+  if (!InitBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
+    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readbackBuffer, readbackBufferMemory)) {
+    return false;
+  }
+
+  VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
+
+  VkBufferImageCopy region = {};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageOffset = {0, 0, 0};
+  region.imageExtent = {width, height, 1};
+
+  vkCmdCopyImageToBuffer(commandBuffer, _vk_swapchain_images[_last_frame], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 
+    readbackBuffer, 1, &region);
+
+  EndSingleTimeCommands(commandBuffer);
+
+  void* data;
+  vkMapMemory(_vk_logical_device, readbackBufferMemory, 0, imageSize, 0, &data);
+  int success = stbi_write_png(path, width, height, 4, data, width * 4);
+  vkUnmapMemory(_vk_logical_device, readbackBufferMemory);
+
+  vkDestroyBuffer(_vk_logical_device, readbackBuffer, nullptr);
+  vkFreeMemory(_vk_logical_device, readbackBufferMemory, nullptr);
+
+  if (!success) {
+    std::cerr << "Failed to write frame to " << path << std::endl;
+    return false;
+  }
+
+  return true;
 }
 
 VkCommandBuffer Renderer::BeginSingleTimeCommands() {
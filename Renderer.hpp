@@ -1,79 +1,259 @@
 #ifndef RENDERER_HPP
 #define RENDERER_HPP
 
+#include "AssetLoader.hpp"
+#include "FrameSnapshot.hpp"
+#include "FrameStats.hpp"
+#include "PipelineManager.hpp"
 #include "RenderDeviceManager.hpp"
+#include "Profiler.hpp"
+#include "RenderGraph.hpp"
+#include "RenderQueue.hpp"
+#include "Resource.hpp"
+#include "TextureManager.hpp"
+#include "Tilemap.hpp"
+#include "Vertex.hpp"
+#include "WorkerPool.hpp"
 
+#include <atomic>
+#include <memory>
+#include <utility>
 #include <vector>
 
+// Trades input-to-photon latency against keeping the GPU busy
+enum class LatencyMode {
+  LowLatency, // one frame in flight, MAILBOX or IMMEDIATE
+  VSync,      // two frames in flight, FIFO
+  Throughput  // three frames in flight, MAILBOX if available
+};
+
+struct FrameResources {
+  VkCommandPool command_pool = VK_NULL_HANDLE;
+  VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+  // One pool per recording job since command pools can't be shared between threads
+  std::vector<VkCommandPool> secondary_pools;
+  std::vector<VkCommandBuffer> secondary_buffers;
+  VkBuffer sprite_buffer = VK_NULL_HANDLE;
+  VkDeviceMemory sprite_buffer_memory = VK_NULL_HANDLE;
+  void* sprite_vertices = nullptr; // persistently mapped, four per quad in sorted order
+  glm::vec2 sprite_origin = {0.0f, 0.0f}; // packed sprite positions are relative to this
+  size_t sprite_capacity = 0;
+  // Two timestamps per zone, read back once the frame's fence signals
+  VkQueryPool timestamp_pool = VK_NULL_HANDLE;
+  bool timestamps_active = false;
+  std::vector<const char*> gpu_zones;
+  // Buffers replaced while other frames could still read them, freed once this frame's fence signals again
+  std::vector<std::pair<VkBuffer, VkDeviceMemory>> retired_buffers;
+  std::vector<uint32_t> retired_textures; // slots stay taken until then
+  // Texture and tilemap uploads made while the frame is prepared, submitted ahead of command_buffer
+  VkCommandPool upload_pool = VK_NULL_HANDLE;
+  VkCommandBuffer upload_buffer = VK_NULL_HANDLE;
+  bool uploads_recorded = false;
+  // Written by the cull pass: the GPU sprites that survived and the indirect draw that consumes them
+  VkBuffer cull_instance_buffer = VK_NULL_HANDLE;
+  VkDeviceMemory cull_instance_buffer_memory = VK_NULL_HANDLE;
+  VkBuffer cull_indirect_buffer = VK_NULL_HANDLE;
+  VkDeviceMemory cull_indirect_buffer_memory = VK_NULL_HANDLE;
+  size_t cull_capacity = 0;
+  VkDescriptorSet cull_descriptor_set = VK_NULL_HANDLE;
+  uint64_t cull_generation = 0; // GPU sprite set the descriptor set was written for, 0 for none
+  bool culled = false; // the cull pass ran for this frame, so the indirect draw is valid
+  // Only created when compute runs on a different queue family than graphics
+  VkCommandPool compute_pool = VK_NULL_HANDLE;
+  VkCommandBuffer compute_buffer = VK_NULL_HANDLE;
+  VkSemaphore compute_finished = VK_NULL_HANDLE;
+  // Main pass framebuffers per swapchain image with this frame's depth image, made on first use
+  std::vector<VkFramebuffer> depth_framebuffers;
+  VkImageView depth_view = VK_NULL_HANDLE; // the depth image they were made with
+  // Rebuilt every frame, kept per frame since their transient images live as long as the command buffers
+  std::unique_ptr<RenderGraph> graph;
+  std::unique_ptr<RenderGraph> compute_graph;
+};
+
+struct Texture {
+  VkImage image = VK_NULL_HANDLE;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkImageView view = VK_NULL_HANDLE;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  bool retired = false; // released, draws with the atlas until the frames that could sample it are done
+};
+
+// Static geometry of one tilemap chunk, device local. Drawn with the shared quad indices.
+struct ChunkBuffers {
+  VkBuffer vertex_buffer = VK_NULL_HANDLE;
+  VkDeviceMemory vertex_buffer_memory = VK_NULL_HANDLE;
+  uint32_t quad_count = 0;
+  glm::vec2 origin = {0.0f, 0.0f}; // packed positions are relative to this
+};
+
 class Renderer {
 public:
   Renderer();
   ~Renderer();
   bool Init(GLFWwindow* window, const char* game_name, const char* engine_name, const std::vector<const char*>& extensions);
+  // Renders into offscreen images instead of a window surface, e.g. for benchmarks on machines without a display
+  bool InitHeadless(uint32_t width, uint32_t height, const char* game_name, const char* engine_name, 
+    const std::vector<const char*>& extensions);
   bool DebugEnabled();
+  bool Headless() const;
   VkInstance GetVKInstance();
   VkSurfaceKHR GetVKSurface();
   const std::vector<const char*> GetRequiredExtensions() const;
-  void DrawFrame();
-  
-  bool framebuffer_resized = false;
+  void DrawFrame(const FrameSnapshot& snapshot);
+  // Writes the most recently drawn frame to a PNG, headless only
+  bool SaveFrame(const char* path);
+  FrameStats& GetFrameStats();
+  // Streams the atlas pages sprites refer to
+  TextureManager& GetTextureManager();
+  // Completion callbacks run on the thread that draws, at the start of each frame
+  AssetLoader& GetAssetLoader();
+  // Uploads RGBA8 pixels and returns the texture's index, -1 on failure. Call these from the thread that
+  // draws. While a frame is prepared the upload goes in that frame's submit, otherwise it blocks.
+  int32_t CreateTexture(const void* pixels, uint32_t width, uint32_t height);
+  int32_t LoadTexture(const char* path);
+  // Frees the texture once the frames in flight are done with it, then its index is reused by
+  // CreateTexture. The atlas can't be released.
+  void ReleaseTexture(uint32_t texture);
+  // Whether sprites with different textures can share a draw
+  bool BindlessTextures() const;
+  // Can be called before Init, otherwise resizes the frame resources and recreates the swapchain
+  bool SetLatencyMode(LatencyMode mode);
+  LatencyMode GetLatencyMode() const;
+  static const char* LatencyModeName(LatencyMode mode);
+  // Only before Init, the sprite and tile buffers are sized for it
+  bool SetVertexFormat(VertexFormat format);
+  VertexFormat GetVertexFormat() const;
+  // Only before Init. Gives the main pass a depth attachment and turns sprite layers into depth: opaque
+  // sprites draw front to back with depth test and write, so fragments they cover are never shaded, and
+  // only translucent ones are sorted back to front over them. Within a layer translucent sprites land
+  // on top of opaque ones regardless of their order.
+  bool SetDepthLayering(bool enabled);
+  bool DepthLayering() const;
+  // Safe to call from the thread pumping window events while another one draws
+  void NotifyFramebufferResized(int width, int height);
 
 protected:
+  bool InitRenderer(const char* game_name, const char* engine_name, const std::vector<const char*>& extensions);
   bool InitInstance(const char* game_name, const char* engine_name, const std::vector<const char*>& extensions);
   bool InitLogicalDevice();
   bool InitSurface();
-  bool InitSwapChain();
+  bool InitSwapChain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
+  bool InitOffscreenTargets();
+  void DestroyOffscreenTargets();
   void DestroySwapChain();
+  void DestroySwapChainImages();
+  void DestroyUniformBuffers();
   bool ResetSwapChain();
+  // Creates the layout and registers the pipelines every frame uses, WaitForPipelines blocks until they exist
   bool InitGraphicsPipeline();
-  bool InitShader(VkShaderModule& shader_module, const std::vector<char>& code);
+  bool WaitForPipelines();
+  bool InitCullPipeline();
   bool InitDescriptorSetLayout();
   bool InitDescriptorSets();
   bool InitDescriptorPool();
+  bool AddDescriptorPool(uint32_t setCount);
+  bool AllocateDescriptorSets(size_t count);
+  void WriteDescriptorSets(size_t first);
   bool InitRenderPass();
   bool InitFramebuffers();
   bool InitCommandPool();
   bool InitTextureImage();
-  bool InitTextureImageView();
+  bool UploadTexture(Texture& texture, const void* pixels, uint32_t width, uint32_t height);
+  void DestroyTexture(Texture& texture);
+  VkCommandBuffer BeginFrameUploads(FrameResources& frame);
+  bool UpdateTextureDescriptors(uint32_t texture);
+  VkDescriptorSet GetDescriptorSet(uint32_t imageIndex, uint32_t texture) const;
+  VkImageView GetTextureView(uint32_t texture) const;
   bool InitTextureSampler();
   bool InitImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
   bool InitImageView(VkImageView& imageView, VkImage image, VkFormat format);
   bool InitImageViews();
-  bool TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
+  // The main pass framebuffer for a swapchain image, with depthView when depth layering is on
+  VkFramebuffer GetFramebuffer(FrameResources& frame, uint32_t imageIndex, VkImageView depthView);
+  void DestroyDepthFramebuffers(FrameResources& frame);
+  // Records a color image transition between two accesses, see RenderGraph
+  void TransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, Access from, Access to);
   bool InitCommandBuffers();
+  void DestroyCommandBuffers();
+  bool ReserveSpriteBuffer(FrameResources& frame, size_t sprite_count);
+  void DestroySpriteBuffer(FrameResources& frame);
+  void UpdateTilemap(FrameResources& frame, const std::shared_ptr<Tilemap>& tilemap, const Camera& camera);
+  bool RebuildDirtyChunks(FrameResources& frame);
+  void RetireChunkBuffers(FrameResources& frame, ChunkBuffers& buffers);
+  void FreeRetiredBuffers(FrameResources& frame);
+  void UpdateGpuSprites(FrameResources& frame, const std::shared_ptr<const std::vector<GpuSprite>>& sprites);
+  bool ReserveCullBuffers(FrameResources& frame, size_t sprite_count);
+  void DestroyCullBuffers(FrameResources& frame);
+  // Resets the indirect draw and culls the GPU sprites into instances. timed adds a GPU zone, only for the
+  // graphics command buffer.
+  void AddCullPasses(RenderGraph& graph, FrameResources& frame, const Camera& camera, RenderResource instances, 
+    RenderResource indirect, bool timed);
+  bool SubmitCull(FrameResources& frame, const Camera& camera);
+  void BuildRenderQueue(const std::vector<Sprite>& sprites);
+  void WriteSpriteVertices(FrameResources& frame, const std::vector<Sprite>& sprites, float alpha);
+  void RecordCommandBuffer(FrameResources& frame, uint32_t imageIndex, const std::vector<Sprite>& sprites, float alpha, 
+    const Camera& camera);
+  bool InitTimestampQueries();
+  void CalibrateGpuClock();
+  uint32_t BeginGpuZone(FrameResources& frame, VkCommandBuffer commandBuffer, const char* name);
+  void EndGpuZone(FrameResources& frame, VkCommandBuffer commandBuffer, uint32_t zone);
+  void CollectGpuTimings(FrameResources& frame);
+  void RecordDraws(VkCommandBuffer commandBuffer, FrameResources& frame, uint32_t imageIndex, size_t firstBatch, size_t batchCount, 
+    bool drawStatic);
   bool InitSyncObjects();
+  void DestroySyncObjects();
   bool InitVertexBuffer();
   bool InitIndexBuffer();
-  bool InitBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+  // shareWithCompute makes the buffer concurrent between the graphics and compute families when they differ
+  bool InitBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory,
+    bool shareWithCompute = false);
   void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-  void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+  void CopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
   bool InitUniformBuffers();
-  void UpdateUniformBuffer(uint32_t currentImage);
+  void UpdateUniformBuffer(uint32_t currentImage, const Camera& camera);
   VkCommandBuffer BeginSingleTimeCommands();
   void EndSingleTimeCommands(VkCommandBuffer commandBuffer);
   bool HasValidationSupport();
   void PrintExtensions();
   
   GLFWwindow* _window;
+  // GLFW only hands out the framebuffer size on the main thread, the event callback keeps these current
+  std::atomic<int> _framebuffer_width{0};
+  std::atomic<int> _framebuffer_height{0};
+  std::atomic<bool> _framebuffer_resized{false};
   VkInstance _vk_instance;
   VkDevice _vk_logical_device;
   VkQueue _vk_graphics_queue; //these two queues are likely the same but could be different
   VkQueue _vk_present_queue;
+  VkQueue _vk_compute_queue = VK_NULL_HANDLE;
+  int _compute_queue_family = -1; // -1 if the device can't run compute, GPU sprites are skipped then
+  bool _separate_compute = false; // compute has its own family, so the cull pass is its own submit
   VkSurfaceKHR _vk_surface;
-  VkSwapchainKHR _vk_swapchain;
+  VkSwapchainKHR _vk_swapchain = VK_NULL_HANDLE;
   VkExtent2D _vk_swapchain_extent;
   VkFormat _vk_swapchain_image_format;
   std::vector<VkImage> _vk_swapchain_images;
   std::vector<VkImageView> _vk_swapchain_image_views;
+  std::vector<VkDeviceMemory> _vk_offscreen_images_memory;
   VkRenderPass _vk_render_pass;
   VkDescriptorSetLayout _vk_descriptor_set_layout;
   std::vector<VkFramebuffer> _vk_swapchain_framebuffers;
   VkPipelineLayout _vk_pipeline_layout;
-  VkPipeline _vk_graphics_pipeline;
+  PipelineManager _pipelines;
+  uint32_t _sprite_pipeline = 0; // PipelineManager ids
+  uint32_t _stream_pipeline = 0; // sprites and tiles, _sprite_pipeline unless they're packed
+  uint32_t _instanced_pipeline = 0;
+  uint32_t _opaque_pipeline = 0; // sprites with depth layering, otherwise both are _stream_pipeline
+  uint32_t _translucent_pipeline = 0;
+  VkDescriptorSetLayout _vk_cull_descriptor_set_layout = VK_NULL_HANDLE;
+  VkPipelineLayout _vk_cull_pipeline_layout = VK_NULL_HANDLE;
+  VkPipeline _vk_cull_pipeline = VK_NULL_HANDLE;
+  VkDescriptorPool _vk_cull_descriptor_pool = VK_NULL_HANDLE;
   VkCommandPool _vk_command_pool;
-  VkImage _vk_texture_image;
-  VkDeviceMemory _vk_texture_image_memory;
-  VkImageView _vk_texture_image_view;
+  std::vector<Texture> _textures;
+  bool _bindless = false; // one descriptor array holds every texture, otherwise one set per image and texture
+  uint32_t _max_textures = 1;
   VkSampler _vk_texture_sampler;
   VkBuffer _vk_vertex_buffer;
   VkDeviceMemory _vk_vertex_buffer_memory;
@@ -81,19 +261,49 @@ protected:
   VkDeviceMemory _vk_index_buffer_memory;
   std::vector<VkBuffer> _vk_uniform_buffers;
   std::vector<VkDeviceMemory> _vk_uniform_buffers_memory;
-  VkDescriptorPool _vk_descriptor_pool;
+  // Sets are allocated from the last pool, a full one is kept and a larger one added
+  std::vector<VkDescriptorPool> _vk_descriptor_pools;
+  uint32_t _descriptor_pool_free = 0; // sets left in the last pool
   std::vector<VkDescriptorSet> _vk_descriptor_sets;
-  std::vector<VkCommandBuffer> _vk_command_buffers;
+  std::vector<FrameResources> _frames;
   std::vector<VkSemaphore> _vk_image_available_semaphores;
   std::vector<VkSemaphore> _vk_render_finished_semaphores;
   std::vector<VkFence> _vk_in_flight_fences;
   size_t _current_frame = 0;
+  FrameResources* _preparing_frame = nullptr; // between its fence wait and its submit
+  LatencyMode _latency_mode = LatencyMode::VSync;
+  VertexFormat _vertex_format = VertexFormat::Full;
+  bool _depth_layering = false;
+  bool _gpu_timestamps = false;
+  bool _gpu_calibrated_timestamps = false;
+  double _gpu_timestamp_period = 1.0; // nanoseconds per tick
+  uint64_t _gpu_timestamp_mask = 0;
+  int64_t _gpu_clock_offset = 0; // added to GPU nanoseconds to land on Profiler::Now()
+  int64_t _gpu_last_calibration = 0;
+  PFN_vkGetCalibratedTimestampsEXT _vkGetCalibratedTimestampsEXT = nullptr;
+  size_t _last_frame = 0;
+  bool _headless = false;
   VkDebugUtilsMessengerEXT _vk_debug_messenger;
   std::vector<VkExtensionProperties> _vk_extensions;
   const std::vector<const char*> _vk_validation_layers = std::vector<const char*>({ "VK_LAYER_KHRONOS_validation" });
   const std::vector<const char*> _vk_required_extenstions = std::vector<const char*>({ VK_KHR_SWAPCHAIN_EXTENSION_NAME });
   std::vector<VkLayerProperties> _vk_layer_properties;
   RenderDeviceManager _device_manager;
+  WorkerPool _workers;
+  RenderQueue _render_queue;
+  AssetLoader _asset_loader;
+  TextureManager _texture_manager{*this, _asset_loader};
+  std::shared_future<Image> _atlas; // decoded while the device and pipelines are set up
+  std::vector<uint32_t> _sprite_textures; // renderer texture of each snapshot sprite
+  std::shared_ptr<Tilemap> _tilemap;
+  std::vector<ChunkBuffers> _chunk_buffers;
+  std::vector<uint32_t> _visible_chunks;
+  std::shared_ptr<const std::vector<GpuSprite>> _gpu_sprites;
+  VkBuffer _gpu_sprite_buffer = VK_NULL_HANDLE;
+  VkDeviceMemory _gpu_sprite_buffer_memory = VK_NULL_HANDLE;
+  uint32_t _gpu_sprite_count = 0;
+  uint64_t _gpu_sprite_generation = 0;
+  FrameStats _frame_stats;
   
   #ifdef NDEBUG
   const bool _enable_validation_layers = false;
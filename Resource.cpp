@@ -1,6 +1,53 @@
 #include "Resource.hpp"
 
-Resource::Resource(const char *start, const char *end): _data(start, start+(end - start)) {}
-const std::vector<char>& Resource::data() const {
+#include <stb_image.h>
+
+#include <cstring>
+#include <iostream>
+
+Resource::Resource(const char* start, const char* end) : _data(start), _size(static_cast<size_t>(end - start)) {}
+
+Resource::Resource(const char* start, size_t size) : _data(start), _size(size) {}
+
+const char* Resource::data() const {
   return _data;
 }
+
+size_t Resource::size() const {
+  return _size;
+}
+
+bool Resource::empty() const {
+  return _size == 0;
+}
+
+const char* Resource::begin() const {
+  return _data;
+}
+
+const char* Resource::end() const {
+  return _data + _size;
+}
+
+CompressedResource::CompressedResource(const char* start, const char* end) : _compressed(start, end) {}
+
+Resource CompressedResource::Get() {
+  std::call_once(_inflated, [this]() {
+    uint64_t size = 0;
+    if (_compressed.size() < sizeof(size)) return;
+    std::memcpy(&size, _compressed.data(), sizeof(size));
+
+    _words.resize((static_cast<size_t>(size) + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+    int inflated = stbi_zlib_decode_buffer(reinterpret_cast<char*>(_words.data()), static_cast<int>(size),
+      _compressed.data() + sizeof(size), static_cast<int>(_compressed.size() - sizeof(size)));
+
+    if (inflated != static_cast<int>(size)) {
+      std::cerr << "Failed to inflate embedded resource" << std::endl;
+      _words.clear();
+      return;
+    }
+    _size = static_cast<size_t>(size);
+  });
+
+  return Resource(reinterpret_cast<const char*>(_words.data()), _size);
+}
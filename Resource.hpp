@@ -1,20 +1,59 @@
 #ifndef RESOURCE_HPP
 #define RESOURCE_HPP
 
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 #include <vector>
 
+// Embedded resources start on a 16 byte boundary, see add_resource in CMakeLists.txt
+static const size_t RESOURCE_ALIGNMENT = 16;
+
+// Read-only view of bytes someone else owns, an embedded blob or an entry of a mapped archive. Nothing
+// is copied, the view is only valid while the owner is.
 class Resource {
 public:
+  Resource() = default;
   Resource(const char* start, const char* end);
-  const std::vector<char>& data() const; 
+  Resource(const char* start, size_t size);
+
+  const char* data() const;
+  size_t size() const;
+  bool empty() const;
+  const char* begin() const;
+  const char* end() const;
 
 private:
-  std::vector<char> _data;
+  const char* _data = nullptr;
+  size_t _size = 0;
 };
 
+// Blob deflated at build time with COMPRESS_RESOURCES. The first Get inflates it into a buffer that
+// lives as long as this does, later ones return the same view.
+class CompressedResource {
+public:
+  CompressedResource(const char* start, const char* end);
+  Resource Get();
+
+private:
+  Resource _compressed; // uncompressed size as a little endian uint64_t, then a zlib stream
+  std::once_flag _inflated;
+  std::vector<uint32_t> _words; // keeps the inflated bytes aligned for SPIR-V
+  size_t _size = 0;
+};
+
+// Each expansion inflates its own copy, so load a compressed resource from one place
+#ifdef COMPRESSED_RESOURCES
+#define LOAD_RESOURCE(x) ([]() {                                      \
+  extern const char _binary_##x##_start, _binary_##x##_end;           \
+  static CompressedResource resource(&_binary_##x##_start, &_binary_##x##_end); \
+  return resource.Get();                                              \
+})()
+#else
 #define LOAD_RESOURCE(x) ([]() {                                      \
   extern const char _binary_##x##_start, _binary_##x##_end;           \
   return Resource(&_binary_##x##_start, &_binary_##x##_end);          \
 })()
+#endif
 
 #endif
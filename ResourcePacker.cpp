@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "Archive.hpp"
+
+// Packs files into an archive the client maps at startup, see Archive.hpp for the layout. Entries are
+// named by their path as given, so run it from the directory the client loads from.
+//
+//   ResourcePacker <archive> [--compress] <file>...
+//   ResourcePacker --deflate <file> <output>
+//
+// With --compress every entry is deflated, unless that doesn't make it smaller. Images and SPIR-V
+// that are read straight out of the mapping are better left uncompressed.
+//
+// --deflate writes a single file in the form CompressedResource reads, the build uses it for embedded
+// resources when COMPRESS_RESOURCES is on.
+
+struct PackedFile {
+  std::string name;
+  std::vector<char> data;
+  ArchiveCompression compression = ArchiveCompression::None;
+  uint64_t size = 0;
+};
+
+static bool read_file(const std::string& path, std::vector<char>& data) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) return false;
+
+  data.resize(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(data.data(), data.size());
+  return static_cast<bool>(file);
+}
+
+static void compress(PackedFile& packed) {
+  int length = 0;
+  unsigned char* deflated = stbi_zlib_compress(reinterpret_cast<unsigned char*>(packed.data.data()),
+    static_cast<int>(packed.data.size()), &length, 8);
+
+  if (deflated != nullptr && static_cast<size_t>(length) < packed.data.size()) {
+    packed.data.assign(deflated, deflated + length);
+    packed.compression = ArchiveCompression::Zlib;
+  }
+  STBIW_FREE(deflated);
+}
+
+static uint64_t align(uint64_t offset) {
+  return (offset + ARCHIVE_ALIGNMENT - 1) / ARCHIVE_ALIGNMENT * ARCHIVE_ALIGNMENT;
+}
+
+static int deflate_file(const char* input, const char* output) {
+  PackedFile packed;
+  if (!read_file(input, packed.data)) {
+    std::cerr << "Failed to read: " << input << std::endl;
+    return 1;
+  }
+
+  uint64_t size = packed.data.size();
+  int length = 0;
+  unsigned char* deflated = stbi_zlib_compress(reinterpret_cast<unsigned char*>(packed.data.data()),
+    static_cast<int>(packed.data.size()), &length, 8);
+
+  std::ofstream out(output, std::ios::binary);
+  out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+  out.write(reinterpret_cast<const char*>(deflated), length);
+  STBIW_FREE(deflated);
+
+  if (deflated == nullptr || !out) {
+    std::cerr << "Failed to write: " << output << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc == 4 && std::strcmp(argv[1], "--deflate") == 0)
+    return deflate_file(argv[2], argv[3]);
+
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <archive> [--compress] <file>..." << std::endl;
+    std::cerr << "       " << argv[0] << " --deflate <file> <output>" << std::endl;
+    return 1;
+  }
+
+  bool compressEntries = false;
+  std::vector<PackedFile> files;
+  for (int i = 2; i < argc; i++) {
+    if (std::strcmp(argv[i], "--compress") == 0) {
+      compressEntries = true;
+      continue;
+    }
+
+    PackedFile packed;
+    packed.name = argv[i];
+    if (!read_file(packed.name, packed.data)) {
+      std::cerr << "Failed to read: " << packed.name << std::endl;
+      return 1;
+    }
+    packed.size = packed.data.size();
+    files.push_back(std::move(packed));
+  }
+
+  if (compressEntries) {
+    for (PackedFile& packed : files)
+      compress(packed);
+  }
+
+  // The client binary searches the entry table
+  std::sort(files.begin(), files.end(), [](const PackedFile& a, const PackedFile& b) { return a.name < b.name; });
+
+  std::string names;
+  std::vector<ArchiveEntry> entries(files.size());
+  for (size_t i = 0; i < files.size(); i++) {
+    entries[i].name_offset = static_cast<uint32_t>(names.size());
+    entries[i].name_length = static_cast<uint32_t>(files[i].name.size());
+    names += files[i].name;
+  }
+
+  ArchiveHeader header = {};
+  std::memcpy(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+  header.version = ARCHIVE_VERSION;
+  header.entry_count = static_cast<uint32_t>(entries.size());
+  header.names_size = static_cast<uint32_t>(names.size());
+
+  uint64_t offset = sizeof(header) + entries.size() * sizeof(ArchiveEntry) + names.size();
+  for (size_t i = 0; i < files.size(); i++) {
+    offset = align(offset);
+    entries[i].offset = offset;
+    entries[i].stored_size = files[i].data.size();
+    entries[i].size = files[i].size;
+    entries[i].compression = files[i].compression;
+    offset += files[i].data.size();
+  }
+
+  std::ofstream out(argv[1], std::ios::binary);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ArchiveEntry));
+  out.write(names.data(), names.size());
+
+  for (size_t i = 0; i < files.size(); i++) {
+    std::vector<char> padding(entries[i].offset - static_cast<uint64_t>(out.tellp()), 0);
+    out.write(padding.data(), padding.size());
+    out.write(files[i].data.data(), files[i].data.size());
+  }
+
+  if (!out) {
+    std::cerr << "Failed to write: " << argv[1] << std::endl;
+    return 1;
+  }
+
+  std::cout << "Packed " << files.size() << " files into " << argv[1] << " (" << offset << " bytes)" << std::endl;
+  return 0;
+}
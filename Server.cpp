@@ -1,8 +1,11 @@
 #include "flatbuffers/User_generated.h"
 
+#include "Tick.hpp"
+
 #include <enet/enet.h>
 
 #include <iostream>
+#include <algorithm>
 #include <cstdio>
 
 ENetPacket* NewUser(unsigned id, const ENetAddress* address) {
@@ -59,10 +62,25 @@ public:
     return true;
   }
 
-  void Poll() {
+  // Services the network until the next tick is due, then runs every tick that is
+  void Update() {
+    int64_t untilNextTick = _timestep.NextTickTime() - TickClockNow();
+    Poll(static_cast<uint32_t>(std::max<int64_t>(untilNextTick / 1000000, 0)));
+
+    unsigned ticks = _timestep.Advance(TickClockNow());
+    for (unsigned i = 0; i < ticks; ++i) {
+      Simulate();
+    }
+  }
+
+  // Same fixed step as the client so tick numbers line up
+  void Simulate() {
+  }
+
+  void Poll(uint32_t timeout_ms) {
     ENetEvent event;
-    /* Wait up to 1000 milliseconds for an event. */
-    while (enet_host_service (_server, & event, 1000) > 0) {
+    /* Wait up to timeout_ms milliseconds for an event. */
+    while (enet_host_service (_server, & event, timeout_ms) > 0) {
         switch (event.type) {
           case ENET_EVENT_TYPE_CONNECT: {
               printf ("A new client connected from %x:%u.\n", 
@@ -91,6 +109,9 @@ public:
               event.peer -> data = NULL;
               //_user_count--;
         }
+
+        // Only the first wait may block, the rest just drain what already arrived so the tick isn't late
+        timeout_ms = 0;
       }
     }
 
@@ -98,6 +119,7 @@ protected:
   ENetAddress _address;
   ENetHost* _server;
   unsigned _user_count = 0;
+  FixedTimestep _timestep;
 };
 
 int main() {
@@ -106,7 +128,7 @@ int main() {
   if (!server.Init("127.0.0.1", 1234, 32))
     return EXIT_FAILURE;
 
-  while(true) server.Poll();
+  while(true) server.Update();
 
   return EXIT_SUCCESS;
 }
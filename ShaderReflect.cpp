@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Reads compiled SPIR-V and writes the descriptor bindings, vertex inputs and push constant size of each
+// shader as constexpr tables, see ShaderReflection.hpp. Only handles what our shaders use.
+//
+//   ShaderReflect <header> <shader.spv>...
+
+static const uint32_t SPIRV_MAGIC = 0x07230203;
+
+enum Op : uint32_t {
+  OpEntryPoint = 15,
+  OpTypeInt = 21,
+  OpTypeFloat = 22,
+  OpTypeVector = 23,
+  OpTypeMatrix = 24,
+  OpTypeImage = 25,
+  OpTypeSampler = 26,
+  OpTypeSampledImage = 27,
+  OpTypeArray = 28,
+  OpTypeRuntimeArray = 29,
+  OpTypeStruct = 30,
+  OpTypePointer = 32,
+  OpConstant = 43,
+  OpVariable = 59,
+  OpDecorate = 71,
+  OpMemberDecorate = 72
+};
+
+enum Decoration : uint32_t {
+  DecorationBlock = 2,
+  DecorationBufferBlock = 3,
+  DecorationArrayStride = 6,
+  DecorationBuiltIn = 11,
+  DecorationLocation = 30,
+  DecorationBinding = 33,
+  DecorationDescriptorSet = 34,
+  DecorationOffset = 35
+};
+
+enum StorageClass : uint32_t {
+  StorageUniformConstant = 0,
+  StorageInput = 1,
+  StorageUniform = 2,
+  StoragePushConstant = 9,
+  StorageStorageBuffer = 12
+};
+
+struct Decorations {
+  std::map<uint32_t, uint32_t> values; // decoration -> first operand, 0 if it has none
+  std::map<uint32_t, uint32_t> member_offsets;
+
+  bool Has(uint32_t decoration) const { return values.count(decoration) != 0; }
+  uint32_t Get(uint32_t decoration) const { return Has(decoration) ? values.at(decoration) : 0; }
+};
+
+struct Variable {
+  uint32_t type;
+  uint32_t id;
+  uint32_t storage;
+};
+
+struct Module {
+  uint32_t execution_model = 0;
+  std::map<uint32_t, std::vector<uint32_t>> types; // result id -> opcode followed by the other operands
+  std::map<uint32_t, uint32_t> constants;
+  std::map<uint32_t, Decorations> decorations;
+  std::vector<Variable> variables;
+};
+
+static bool read_module(const std::string& path, Module& module) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) return false;
+
+  std::vector<uint32_t> words(static_cast<size_t>(file.tellg()) / sizeof(uint32_t));
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(words.data()), words.size() * sizeof(uint32_t));
+  if (words.size() < 5 || words[0] != SPIRV_MAGIC) return false;
+
+  for (size_t i = 5; i < words.size();) {
+    uint32_t count = words[i] >> 16;
+    uint32_t opcode = words[i] & 0xFFFF;
+    if (count == 0 || i + count > words.size()) return false;
+    const uint32_t* operands = &words[i + 1];
+
+    switch (opcode) {
+      case OpEntryPoint:
+        module.execution_model = operands[0];
+        break;
+      case OpTypeInt:
+      case OpTypeFloat:
+      case OpTypeVector:
+      case OpTypeMatrix:
+      case OpTypeImage:
+      case OpTypeSampler:
+      case OpTypeSampledImage:
+      case OpTypeArray:
+      case OpTypeRuntimeArray:
+      case OpTypeStruct:
+      case OpTypePointer: {
+        std::vector<uint32_t>& type = module.types[operands[0]];
+        type.push_back(opcode);
+        type.insert(type.end(), operands + 1, operands + count - 1);
+        break;
+      }
+      case OpConstant:
+        module.constants[operands[1]] = operands[2];
+        break;
+      case OpVariable:
+        module.variables.push_back({operands[0], operands[1], operands[2]});
+        break;
+      case OpDecorate:
+        module.decorations[operands[0]].values[operands[1]] = (count > 3) ? operands[2] : 0;
+        break;
+      case OpMemberDecorate:
+        if (operands[2] == DecorationOffset)
+          module.decorations[operands[0]].member_offsets[operands[1]] = operands[3];
+        break;
+    }
+
+    i += count;
+  }
+
+  return true;
+}
+
+static uint32_t type_size(const Module& module, uint32_t id) {
+  const std::vector<uint32_t>& type = module.types.at(id);
+  switch (type[0]) {
+    case OpTypeInt:
+    case OpTypeFloat:
+      return type[1] / 8;
+    case OpTypeVector:
+    case OpTypeMatrix:
+      return type[2] * type_size(module, type[1]);
+    case OpTypeArray: {
+      uint32_t stride = module.decorations.count(id) ? module.decorations.at(id).Get(DecorationArrayStride) : 0;
+      if (stride == 0) stride = type_size(module, type[1]);
+      return module.constants.at(type[2]) * stride;
+    }
+    case OpTypeStruct: {
+      uint32_t size = 0;
+      for (size_t member = 1; member < type.size(); member++) {
+        uint32_t offset = 0;
+        if (module.decorations.count(id) && module.decorations.at(id).member_offsets.count(member - 1))
+          offset = module.decorations.at(id).member_offsets.at(member - 1);
+        size = std::max(size, offset + type_size(module, type[member]));
+      }
+      return size;
+    }
+  }
+  return 0;
+}
+
+static const char* stage_name(uint32_t model) {
+  switch (model) {
+    case 0: return "VK_SHADER_STAGE_VERTEX_BIT";
+    case 1: return "VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT";
+    case 2: return "VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT";
+    case 3: return "VK_SHADER_STAGE_GEOMETRY_BIT";
+    case 4: return "VK_SHADER_STAGE_FRAGMENT_BIT";
+    case 5: return "VK_SHADER_STAGE_COMPUTE_BIT";
+  }
+  return nullptr;
+}
+
+static const char* descriptor_type(const Module& module, const Variable& variable, uint32_t element) {
+  const std::vector<uint32_t>& type = module.types.at(element);
+  bool block = module.decorations.count(element) && module.decorations.at(element).Has(DecorationBlock);
+
+  switch (type[0]) {
+    case OpTypeSampledImage: return "VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER";
+    case OpTypeSampler: return "VK_DESCRIPTOR_TYPE_SAMPLER";
+    // Sampled is 2 for images only used with load and store
+    case OpTypeImage: return (type[6] == 2) ? "VK_DESCRIPTOR_TYPE_STORAGE_IMAGE" : "VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE";
+    case OpTypeStruct:
+      if (variable.storage == StorageStorageBuffer || !block) return "VK_DESCRIPTOR_TYPE_STORAGE_BUFFER";
+      return "VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER";
+  }
+  return nullptr;
+}
+
+static std::string identifier(const std::string& path) {
+  std::string name = path.substr(path.find_last_of('/') + 1);
+  if (name.size() > 4 && name.compare(name.size() - 4, 4, ".spv") == 0)
+    name.resize(name.size() - 4);
+
+  std::replace_if(name.begin(), name.end(), [](char c) { return !isalnum(static_cast<unsigned char>(c)); }, '_');
+  return name;
+}
+
+static bool reflect(const std::string& path, std::ostream& out) {
+  Module module;
+  if (!read_module(path, module)) {
+    std::cerr << "Failed to read SPIR-V: " << path << std::endl;
+    return false;
+  }
+
+  std::string name = identifier(path);
+  const char* stage = stage_name(module.execution_model);
+  if (stage == nullptr) {
+    std::cerr << "Unsupported shader stage in " << path << std::endl;
+    return false;
+  }
+
+  std::ostringstream bindings;
+  uint32_t bindingCount = 0;
+  std::vector<std::pair<uint32_t, std::string>> inputs;
+  uint32_t pushConstantSize = 0;
+
+  for (const Variable& variable : module.variables) {
+    const Decorations& decorations = module.decorations[variable.id];
+    uint32_t pointee = module.types.at(variable.type)[2];
+
+    if (variable.storage == StoragePushConstant) {
+      pushConstantSize = type_size(module, pointee);
+      continue;
+    }
+
+    if (variable.storage == StorageInput && module.execution_model == 0) {
+      if (decorations.Has(DecorationBuiltIn) || !decorations.Has(DecorationLocation)) continue;
+
+      const std::vector<uint32_t>& type = module.types.at(pointee);
+      uint32_t components = (type[0] == OpTypeVector) ? type[2] : 1;
+      const std::vector<uint32_t>& scalar = (type[0] == OpTypeVector) ? module.types.at(type[1]) : type;
+      const char* inputType = "ShaderInputType::Float";
+      if (scalar[0] == OpTypeInt) inputType = scalar[2] ? "ShaderInputType::Sint" : "ShaderInputType::Uint";
+
+      uint32_t location = decorations.Get(DecorationLocation);
+      inputs.push_back({location, "  {" + std::to_string(location) + ", " + inputType + ", " + std::to_string(components) + "},\n"});
+      continue;
+    }
+
+    if (variable.storage != StorageUniformConstant && variable.storage != StorageUniform && variable.storage != StorageStorageBuffer)
+      continue;
+    if (!decorations.Has(DecorationBinding)) continue;
+
+    uint32_t element = pointee;
+    uint32_t count = 1;
+    const std::vector<uint32_t>& type = module.types.at(pointee);
+    if (type[0] == OpTypeArray) {
+      element = type[1];
+      count = module.constants.at(type[2]);
+    } else if (type[0] == OpTypeRuntimeArray) {
+      element = type[1];
+      count = 0;
+    }
+
+    const char* descriptor = descriptor_type(module, variable, element);
+    if (descriptor == nullptr) {
+      std::cerr << "Unsupported descriptor at binding " << decorations.Get(DecorationBinding) << " in " << path << std::endl;
+      return false;
+    }
+
+    bindings << "  {" << decorations.Get(DecorationDescriptorSet) << ", " << decorations.Get(DecorationBinding) << ", "
+      << descriptor << ", " << count << "},\n";
+    bindingCount++;
+  }
+
+  std::sort(inputs.begin(), inputs.end());
+
+  if (bindingCount > 0)
+    out << "static constexpr ShaderBinding " << name << "_bindings[] = {\n" << bindings.str() << "};\n";
+  if (!inputs.empty()) {
+    out << "static constexpr ShaderInput " << name << "_inputs[] = {\n";
+    for (const auto& input : inputs) out << input.second;
+    out << "};\n";
+  }
+
+  out << "static constexpr ShaderReflection " << name << " = {" << stage << ", "
+    << (bindingCount > 0 ? name + "_bindings" : "nullptr") << ", " << bindingCount << ", "
+    << (!inputs.empty() ? name + "_inputs" : "nullptr") << ", " << inputs.size() << ", "
+    << pushConstantSize << "};\n\n";
+
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <header> <shader.spv>..." << std::endl;
+    return 1;
+  }
+
+  std::ostringstream out;
+  out << "// Generated by ShaderReflect from the compiled shaders, don't edit\n"
+    << "#ifndef SHADER_TABLES_HPP\n#define SHADER_TABLES_HPP\n\n"
+    << "#include \"ShaderReflection.hpp\"\n\n"
+    << "namespace shader_tables {\n\n";
+
+  for (int i = 2; i < argc; i++) {
+    if (!reflect(argv[i], out)) return 1;
+  }
+
+  out << "}\n\n#endif\n";
+
+  // Left alone when nothing changed so the sources including it aren't rebuilt
+  std::ifstream previous(argv[1]);
+  std::stringstream existing;
+  existing << previous.rdbuf();
+  if (previous && existing.str() == out.str()) return 0;
+
+  std::ofstream header(argv[1]);
+  header << out.str();
+  if (!header) {
+    std::cerr << "Failed to write: " << argv[1] << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,90 @@
+#include "ShaderReflection.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+static ShaderInputType FormatType(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R8_UINT:
+    case VK_FORMAT_R8G8_UINT:
+    case VK_FORMAT_R8G8B8A8_UINT:
+    case VK_FORMAT_R16_UINT:
+    case VK_FORMAT_R16G16_UINT:
+    case VK_FORMAT_R16G16B16A16_UINT:
+    case VK_FORMAT_R32_UINT:
+    case VK_FORMAT_R32G32_UINT:
+    case VK_FORMAT_R32G32B32_UINT:
+    case VK_FORMAT_R32G32B32A32_UINT:
+      return ShaderInputType::Uint;
+    case VK_FORMAT_R8_SINT:
+    case VK_FORMAT_R8G8_SINT:
+    case VK_FORMAT_R8G8B8A8_SINT:
+    case VK_FORMAT_R16_SINT:
+    case VK_FORMAT_R16G16_SINT:
+    case VK_FORMAT_R16G16B16A16_SINT:
+    case VK_FORMAT_R32_SINT:
+    case VK_FORMAT_R32G32_SINT:
+    case VK_FORMAT_R32G32B32_SINT:
+    case VK_FORMAT_R32G32B32A32_SINT:
+      return ShaderInputType::Sint;
+    default:
+      // Float, normalized and scaled formats all arrive as floats
+      return ShaderInputType::Float;
+  }
+}
+
+bool MergeBindings(std::initializer_list<const ShaderReflection*> stages, uint32_t runtime_array_count,
+  std::vector<VkDescriptorSetLayoutBinding>& bindings, std::vector<VkDescriptorBindingFlagsEXT>& flags) {
+  bindings.clear();
+  flags.clear();
+
+  for (const ShaderReflection* stage : stages) {
+    for (uint32_t i = 0; i < stage->binding_count; i++) {
+      const ShaderBinding& binding = stage->bindings[i];
+      if (binding.set != 0) {
+        std::cerr << "Failed to merge shader bindings, only set 0 is used" << std::endl;
+        return false;
+      }
+
+      uint32_t count = (binding.count == 0) ? runtime_array_count : binding.count;
+      auto existing = std::find_if(bindings.begin(), bindings.end(), [&](const VkDescriptorSetLayoutBinding& b) {
+        return b.binding == binding.binding;
+      });
+
+      // Stages sharing a binding have to agree on what it is
+      if (existing != bindings.end()) {
+        if (existing->descriptorType != binding.type || existing->descriptorCount != count) {
+          std::cerr << "Failed to merge shader bindings, stages disagree on binding " << binding.binding << std::endl;
+          return false;
+        }
+        existing->stageFlags |= stage->stage;
+        continue;
+      }
+
+      VkDescriptorSetLayoutBinding layoutBinding = {};
+      layoutBinding.binding = binding.binding;
+      layoutBinding.descriptorType = binding.type;
+      layoutBinding.descriptorCount = count;
+      layoutBinding.stageFlags = stage->stage;
+      bindings.push_back(layoutBinding);
+      flags.push_back((binding.count == 0) ? VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT : 0);
+    }
+  }
+
+  return true;
+}
+
+bool CheckVertexInputs(const ShaderReflection& shader, const VkVertexInputAttributeDescription* attributes, uint32_t count) {
+  for (uint32_t i = 0; i < shader.input_count; i++) {
+    const ShaderInput& input = shader.inputs[i];
+    const VkVertexInputAttributeDescription* attribute = std::find_if(attributes, attributes + count,
+      [&](const VkVertexInputAttributeDescription& a) { return a.location == input.location; });
+
+    if (attribute == attributes + count || FormatType(attribute->format) != input.type) {
+      std::cerr << "Vertex attribute " << input.location << " doesn't match the shader's input" << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
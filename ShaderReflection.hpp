@@ -0,0 +1,50 @@
+#ifndef SHADER_REFLECTION_HPP
+#define SHADER_REFLECTION_HPP
+
+#include "VulkanHeaders.hpp"
+
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+// What a compiled shader declares, read from its SPIR-V at build time. The ShaderReflect tool writes one
+// constexpr ShaderReflection per shader permutation into ShaderTables.hpp, named after the .spv file
+// (sprite_packed.vert.spv is shader_tables::sprite_packed_vert), so layouts are built from what the
+// shaders actually use instead of being kept in sync by hand.
+
+struct ShaderBinding {
+  uint32_t set;
+  uint32_t binding;
+  VkDescriptorType type;
+  uint32_t count; // 0 for a runtime sized array
+};
+
+enum class ShaderInputType {
+  Float,
+  Uint,
+  Sint
+};
+
+struct ShaderInput {
+  uint32_t location;
+  ShaderInputType type;
+  uint32_t components;
+};
+
+struct ShaderReflection {
+  VkShaderStageFlagBits stage;
+  const ShaderBinding* bindings;
+  uint32_t binding_count;
+  const ShaderInput* inputs; // vertex shaders only
+  uint32_t input_count;
+  uint32_t push_constant_size;
+};
+
+// Layout bindings for set 0 of a pipeline made of these stages. Runtime arrays get runtime_array_count
+// descriptors and VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT in flags, everything else no flags.
+bool MergeBindings(std::initializer_list<const ShaderReflection*> stages, uint32_t runtime_array_count,
+  std::vector<VkDescriptorSetLayoutBinding>& bindings, std::vector<VkDescriptorBindingFlagsEXT>& flags);
+// Whether the attributes feed every input the vertex shader reads with a matching numeric type
+bool CheckVertexInputs(const ShaderReflection& shader, const VkVertexInputAttributeDescription* attributes, uint32_t count);
+
+#endif
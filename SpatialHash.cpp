@@ -0,0 +1,123 @@
+#include "SpatialHash.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+SpatialHash::SpatialHash(float cell_size) : _cell_size(cell_size) {
+}
+
+SpatialHash::CellRange SpatialHash::CellsFor(glm::vec2 min, glm::vec2 max) const {
+  return {
+    static_cast<int32_t>(std::floor(min.x / _cell_size)), static_cast<int32_t>(std::floor(min.y / _cell_size)),
+    static_cast<int32_t>(std::floor(max.x / _cell_size)), static_cast<int32_t>(std::floor(max.y / _cell_size))
+  };
+}
+
+uint64_t SpatialHash::CellKey(int32_t x, int32_t y) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+}
+
+void SpatialHash::Insert(uint32_t id, const CellRange& cells) {
+  for (int32_t y = cells.y0; y <= cells.y1; ++y) {
+    for (int32_t x = cells.x0; x <= cells.x1; ++x) {
+      _cells[CellKey(x, y)].push_back(id);
+    }
+  }
+}
+
+void SpatialHash::Erase(uint32_t id, const CellRange& cells) {
+  for (int32_t y = cells.y0; y <= cells.y1; ++y) {
+    for (int32_t x = cells.x0; x <= cells.x1; ++x) {
+      auto it = _cells.find(CellKey(x, y));
+      if (it == _cells.end()) continue;
+
+      std::vector<uint32_t>& ids = it->second;
+      auto found = std::find(ids.begin(), ids.end(), id);
+      if (found != ids.end()) {
+        *found = ids.back();
+        ids.pop_back();
+      }
+      if (ids.empty()) _cells.erase(it);
+    }
+  }
+}
+
+void SpatialHash::Update(uint32_t id, glm::vec2 min, glm::vec2 max) {
+  if (id >= _items.size()) _items.resize(id + 1);
+
+  Item& item = _items[id];
+  CellRange cells = CellsFor(min, max);
+
+  if (!item.present) {
+    Insert(id, cells);
+    item.present = true;
+    _size++;
+  } else if (!(cells == item.cells)) {
+    Erase(id, item.cells);
+    Insert(id, cells);
+  }
+
+  item.cells = cells;
+  item.min = min;
+  item.max = max;
+}
+
+void SpatialHash::Remove(uint32_t id) {
+  if (id >= _items.size() || !_items[id].present) return;
+
+  Erase(id, _items[id].cells);
+  _items[id].present = false;
+  _size--;
+}
+
+void SpatialHash::Clear() {
+  _cells.clear();
+  _items.clear();
+  _size = 0;
+}
+
+size_t SpatialHash::Size() const {
+  return _size;
+}
+
+void SpatialHash::Visit(uint32_t id, glm::vec2 min, glm::vec2 max, std::vector<uint32_t>& out) {
+  Item& item = _items[id];
+  if (item.query_stamp == _query_stamp) return;
+  item.query_stamp = _query_stamp;
+
+  // Sharing a cell isn't enough, the bounds themselves have to overlap
+  if (item.max.x < min.x || item.min.x > max.x || item.max.y < min.y || item.min.y > max.y) return;
+  out.push_back(id);
+}
+
+void SpatialHash::Query(glm::vec2 min, glm::vec2 max, std::vector<uint32_t>& out) {
+  if (++_query_stamp == 0) {
+    // Wrapped around, stale stamps could now match
+    for (auto& item : _items) item.query_stamp = 0;
+    _query_stamp = 1;
+  }
+
+  CellRange cells = CellsFor(min, max);
+  uint64_t rangeSize = static_cast<uint64_t>(cells.x1 - cells.x0 + 1) * static_cast<uint64_t>(cells.y1 - cells.y0 + 1);
+
+  // Zoomed far out the rect covers more cells than are occupied, walking the occupied ones is cheaper
+  if (rangeSize > _cells.size()) {
+    for (auto& cell : _cells) {
+      int32_t x = static_cast<int32_t>(cell.first >> 32);
+      int32_t y = static_cast<int32_t>(cell.first & 0xFFFFFFFF);
+      if (x < cells.x0 || x > cells.x1 || y < cells.y0 || y > cells.y1) continue;
+
+      for (uint32_t id : cell.second) Visit(id, min, max, out);
+    }
+    return;
+  }
+
+  for (int32_t y = cells.y0; y <= cells.y1; ++y) {
+    for (int32_t x = cells.x0; x <= cells.x1; ++x) {
+      auto it = _cells.find(CellKey(x, y));
+      if (it == _cells.end()) continue;
+
+      for (uint32_t id : it->second) Visit(id, min, max, out);
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef SPATIAL_HASH_HPP
+#define SPATIAL_HASH_HPP
+
+#include "VulkanHeaders.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Uniform grid over world space bounds, only the occupied cells are stored. Items are small integer
+// ids (e.g. entity slots) so they can be moved in place every tick; the grid is only touched when an
+// item crosses into a different set of cells.
+class SpatialHash {
+public:
+  explicit SpatialHash(float cell_size = 256.0f);
+  // Inserts the item or moves it to new bounds
+  void Update(uint32_t id, glm::vec2 min, glm::vec2 max);
+  void Remove(uint32_t id);
+  void Clear();
+  // Appends every item overlapping [min, max] to out, each one once
+  void Query(glm::vec2 min, glm::vec2 max, std::vector<uint32_t>& out);
+  size_t Size() const;
+
+protected:
+  struct CellRange {
+    int32_t x0, y0, x1, y1;
+    bool operator==(const CellRange& o) const { return x0 == o.x0 && y0 == o.y0 && x1 == o.x1 && y1 == o.y1; }
+  };
+
+  struct Item {
+    CellRange cells;
+    glm::vec2 min;
+    glm::vec2 max;
+    uint32_t query_stamp = 0;
+    bool present = false;
+  };
+
+  CellRange CellsFor(glm::vec2 min, glm::vec2 max) const;
+  static uint64_t CellKey(int32_t x, int32_t y);
+  void Insert(uint32_t id, const CellRange& cells);
+  void Erase(uint32_t id, const CellRange& cells);
+  void Visit(uint32_t id, glm::vec2 min, glm::vec2 max, std::vector<uint32_t>& out);
+
+  float _cell_size;
+  std::unordered_map<uint64_t, std::vector<uint32_t>> _cells;
+  std::vector<Item> _items; // indexed by id
+  size_t _size = 0;
+  // Items spanning several cells are only reported once, marked with the stamp of the current query
+  uint32_t _query_stamp = 0;
+};
+
+#endif
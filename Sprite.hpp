@@ -0,0 +1,29 @@
+#ifndef SPRITE_HPP
+#define SPRITE_HPP
+
+#include "VulkanHeaders.hpp"
+
+#include <cstdint>
+
+struct Sprite {
+  glm::vec2 pos;
+  glm::vec2 prev_pos; // position at the previous tick, the renderer interpolates from here to pos
+  glm::vec2 size;
+  glm::vec4 uv; // offset (xy) and extent (zw) of the sprite in the atlas, normalized like AtlasInfo.txt
+  glm::vec3 color;
+  uint32_t layer; // higher layers draw on top
+  uint32_t texture; // page from TextureManager::AddPage, 0 is the atlas
+  // Texels are either solid or fully transparent. With depth layering these skip the back to front
+  // sort and hide whatever they cover, see Renderer::SetDepthLayering.
+  bool opaque = false;
+};
+
+// What a sprite id stands for, entities only store the id
+struct SpriteFrame {
+  glm::vec2 size;
+  glm::vec4 uv;
+  uint32_t texture = 0;
+  bool opaque = false;
+};
+
+#endif
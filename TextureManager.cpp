@@ -0,0 +1,163 @@
+#include "TextureManager.hpp"
+
+#include "Profiler.hpp"
+#include "Renderer.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+// Uploads are recorded into the frame's submit, a few per frame keeps a burst of pages from landing on one frame
+static const size_t MAX_UPLOADS_PER_UPDATE = 2;
+
+TextureManager::TextureManager(Renderer& renderer, AssetLoader& loader) : _renderer(renderer), _loader(loader) {
+  Page atlas;
+  atlas.path = "Atlas.png";
+  atlas.state = PageState::Resident;
+  atlas.pinned = true;
+  _pages.push_back(atlas);
+}
+
+uint32_t TextureManager::AddPage(const std::string& path) {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  Page page;
+  page.path = path;
+  _pages.push_back(page);
+
+  return static_cast<uint32_t>(_pages.size() - 1);
+}
+
+std::shared_future<uint32_t> TextureManager::AddManifest(const std::string& path, bool preload) {
+  auto firstPage = std::make_shared<std::promise<uint32_t>>();
+  std::shared_future<uint32_t> result = firstPage->get_future().share();
+
+  _loader.LoadManifest(path, [this, firstPage, preload](const std::vector<std::string>& paths) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint32_t first = static_cast<uint32_t>(_pages.size());
+
+    for (const std::string& pagePath : paths) {
+      Page page;
+      page.path = pagePath;
+      _pages.push_back(page);
+      if (preload) Request(static_cast<uint32_t>(_pages.size() - 1));
+    }
+
+    firstPage->set_value(first);
+  });
+
+  return result;
+}
+
+void TextureManager::Preload(uint32_t page) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (page < _pages.size()) Request(page);
+}
+
+void TextureManager::Request(uint32_t page) {
+  if (_pages[page].state != PageState::Unloaded) return;
+  _pages[page].state = PageState::Loading;
+
+  // Runs on the render thread once decoded, the upload itself waits for Update
+  _loader.LoadImage(_pages[page].path, [this, page](const Image& image) {
+    _uploading.push_back({page, image});
+  });
+}
+
+void TextureManager::SetBudget(size_t bytes) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _budget = bytes;
+}
+
+size_t TextureManager::ResidentBytes() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _resident_bytes;
+}
+
+bool TextureManager::Init() {
+  // Magenta and black so a page that never arrives is easy to spot
+  const uint32_t checker[4] = {0xFFFF00FF, 0xFF000000, 0xFF000000, 0xFFFF00FF};
+  int32_t placeholder = _renderer.CreateTexture(checker, 2, 2);
+
+  if (placeholder < 0) {
+    std::cerr << "Failed to create placeholder texture" << std::endl;
+    return false;
+  }
+  _placeholder = static_cast<uint32_t>(placeholder);
+
+  return true;
+}
+
+void TextureManager::Update() {
+  PROFILE_SCOPE("UpdateTextures");
+  _frame++;
+
+  for (size_t uploads = 0; uploads < MAX_UPLOADS_PER_UPDATE && !_uploading.empty(); uploads++) {
+    DecodedPage decoded = std::move(_uploading.front());
+    _uploading.pop_front();
+
+    int32_t texture = -1;
+    if (decoded.image.Valid())
+      texture = _renderer.CreateTexture(decoded.image.pixels.get(), decoded.image.width, decoded.image.height);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    Page& page = _pages[decoded.page];
+
+    // Failed pages keep the placeholder instead of being retried every frame
+    if (texture < 0) {
+      std::cerr << "Failed to load texture page " << page.path << std::endl;
+      page.state = PageState::Failed;
+      continue;
+    }
+
+    page.state = PageState::Resident;
+    page.texture = static_cast<uint32_t>(texture);
+    page.bytes = decoded.image.Bytes();
+    _resident_bytes += page.bytes;
+  }
+
+  Evict();
+}
+
+void TextureManager::Evict() {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  while (_resident_bytes > _budget) {
+    // Pages drawn last frame are probably still on screen, staying over budget beats reloading them
+    Page* victim = nullptr;
+    for (Page& page : _pages) {
+      if (page.state != PageState::Resident || page.pinned || page.last_used + 1 >= _frame) continue;
+      if (victim == nullptr || page.last_used < victim->last_used) victim = &page;
+    }
+    if (victim == nullptr) break;
+
+    _renderer.ReleaseTexture(victim->texture);
+    _resident_bytes -= victim->bytes;
+    victim->state = PageState::Unloaded;
+    victim->texture = 0;
+    victim->bytes = 0;
+  }
+}
+
+void TextureManager::Resolve(const std::vector<Sprite>& sprites, std::vector<uint32_t>& textures) {
+  PROFILE_SCOPE("ResolveTextures");
+  textures.resize(sprites.size());
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (size_t i = 0; i < sprites.size(); i++) {
+    uint32_t id = sprites[i].texture;
+    if (id >= _pages.size()) {
+      textures[i] = _placeholder;
+      continue;
+    }
+
+    Page& page = _pages[id];
+    page.last_used = _frame;
+    if (page.state == PageState::Resident) {
+      textures[i] = page.texture;
+      continue;
+    }
+
+    Request(id);
+    textures[i] = _placeholder;
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef TEXTURE_MANAGER_HPP
+#define TEXTURE_MANAGER_HPP
+
+#include "AssetLoader.hpp"
+#include "Sprite.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Renderer;
+
+// Atlas pages that are only resident while they're in use. Sprites refer to pages by id, a page is
+// decoded by the asset loader the first time a sprite uses it and draws with a placeholder until
+// the upload is done. Pages that haven't been drawn for a while are evicted, least recently used
+// first, whenever the resident pages go over the budget.
+//
+// Page 0 is the atlas the renderer loads at startup, it is always resident and never evicted.
+// AddPage, AddManifest, Preload and SetBudget can be called from any thread, everything else is for
+// the renderer.
+class TextureManager {
+public:
+  static const size_t DEFAULT_BUDGET = 256 * 1024 * 1024;
+
+  TextureManager(Renderer& renderer, AssetLoader& loader);
+  TextureManager(const TextureManager&) = delete;
+  TextureManager& operator=(const TextureManager&) = delete;
+
+  // Registers a page without loading it, returns the id sprites use as their texture
+  uint32_t AddPage(const std::string& path);
+  // Registers every page in a manifest once the loader has read it, see AssetLoader::LoadManifest. Pages
+  // get consecutive ids starting at the returned future's value.
+  std::shared_future<uint32_t> AddManifest(const std::string& path, bool preload = false);
+  // Starts loading a page before it's drawn, e.g. everything a level uses while the level is set up
+  void Preload(uint32_t page);
+  // Bytes of texture memory the pages may use, the atlas and the placeholder aren't counted
+  void SetBudget(size_t bytes);
+  size_t ResidentBytes() const;
+
+  // Creates the placeholder, needs the renderer's device
+  bool Init();
+  // Uploads pages that finished decoding and evicts over budget, once a frame before recording. Uploads go
+  // in that frame's submit and evicted textures are freed once the frames in flight are done with them.
+  void Update();
+  // Renderer texture for every sprite's page, requesting the pages that aren't resident yet
+  void Resolve(const std::vector<Sprite>& sprites, std::vector<uint32_t>& textures);
+
+protected:
+  enum class PageState {
+    Unloaded,
+    Loading,
+    Resident,
+    Failed
+  };
+
+  struct Page {
+    std::string path;
+    PageState state = PageState::Unloaded;
+    uint32_t texture = 0; // renderer texture while resident
+    size_t bytes = 0;
+    uint64_t last_used = 0; // frame the page was last drawn in
+    bool pinned = false;
+  };
+
+  struct DecodedPage {
+    uint32_t page;
+    Image image;
+  };
+
+  // Call with _mutex held
+  void Request(uint32_t page);
+  void Evict();
+
+  Renderer& _renderer;
+  AssetLoader& _loader;
+  uint32_t _placeholder = 0;
+  size_t _budget = DEFAULT_BUDGET;
+  size_t _resident_bytes = 0;
+  uint64_t _frame = 0;
+  // Decoded pages arrive through the loader's completions on the render thread, a few are uploaded a frame
+  std::deque<DecodedPage> _uploading;
+
+  // Guards the pages and the budget against AddPage and SetBudget from other threads
+  mutable std::mutex _mutex;
+  std::deque<Page> _pages;
+};
+
+#endif
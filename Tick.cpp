@@ -0,0 +1,40 @@
+#include "Tick.hpp"
+
+#include <chrono>
+
+int64_t TickClockNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FixedTimestep::FixedTimestep(int64_t tick_ns, unsigned max_ticks_per_update) 
+  : _tick_ns(tick_ns), _max_ticks_per_update(max_ticks_per_update) {
+}
+
+unsigned FixedTimestep::Advance(int64_t now_ns) {
+  if (_last_time < 0) _last_time = now_ns;
+
+  _accumulator += now_ns - _last_time;
+  _last_time = now_ns;
+
+  int64_t maxAccumulated = _tick_ns * _max_ticks_per_update;
+  if (_accumulator > maxAccumulated)
+    _accumulator = maxAccumulated;
+
+  unsigned ticks = static_cast<unsigned>(_accumulator / _tick_ns);
+  _accumulator -= ticks * _tick_ns;
+  _tick += ticks;
+
+  return ticks;
+}
+
+int64_t FixedTimestep::NextTickTime() const {
+  return _last_time + (_tick_ns - _accumulator);
+}
+
+uint64_t FixedTimestep::Tick() const {
+  return _tick;
+}
+
+int64_t FixedTimestep::TickLength() const {
+  return _tick_ns;
+}
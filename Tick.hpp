@@ -0,0 +1,36 @@
+#ifndef TICK_HPP
+#define TICK_HPP
+
+#include <cstdint>
+
+// Simulation time only ever advances in whole ticks, shared by the client and the server so tick N
+// means the same thing on both sides
+static const uint32_t TICK_RATE = 60;
+static const int64_t TICK_NS = 1000000000 / TICK_RATE;
+
+// Nanoseconds on the steady clock, the time base for tick times handed between threads
+int64_t TickClockNow();
+
+// Accumulates wall time and turns it into a number of ticks to run. Rendering interpolates towards
+// NextTickTime, so the simulation cost stays bounded however fast frames are drawn.
+class FixedTimestep {
+public:
+  // Past max_ticks_per_update the remaining time is dropped, a long stall then slows the game down
+  // instead of freezing it while it catches up
+  explicit FixedTimestep(int64_t tick_ns = TICK_NS, unsigned max_ticks_per_update = 5);
+  // Feeds in the time since the last call (nanoseconds on any monotonic clock), returns the ticks due
+  unsigned Advance(int64_t now_ns);
+  // Wall clock time at which the next tick is due
+  int64_t NextTickTime() const;
+  uint64_t Tick() const;
+  int64_t TickLength() const;
+
+protected:
+  int64_t _tick_ns;
+  unsigned _max_ticks_per_update;
+  int64_t _accumulator = 0;
+  int64_t _last_time = -1;
+  uint64_t _tick = 0;
+};
+
+#endif
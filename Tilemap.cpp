@@ -0,0 +1,111 @@
+#include "Tilemap.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+Tilemap::Tilemap(uint32_t width, uint32_t height, float tile_size, std::vector<glm::vec4> tile_uvs) 
+  : _width(width), _height(height), _tile_size(tile_size), _tile_uvs(std::move(tile_uvs)) {
+  _chunks_x = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  _chunks_y = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  _tiles.resize(static_cast<size_t>(width) * height, 0);
+  // Every chunk starts out dirty so the first frame builds them all
+  _dirty.resize(static_cast<size_t>(_chunks_x) * _chunks_y, 1);
+}
+
+void Tilemap::SetTile(uint32_t x, uint32_t y, uint16_t tile) {
+  if (x >= _width || y >= _height) return;
+
+  std::lock_guard<std::mutex> lock(_edits_mutex);
+  _edits.push_back({x, y, tile});
+}
+
+void Tilemap::ApplyEdits() {
+  {
+    std::lock_guard<std::mutex> lock(_edits_mutex);
+    _applying.swap(_edits);
+  }
+
+  for (const TileEdit& edit : _applying) {
+    uint16_t& tile = _tiles[static_cast<size_t>(edit.y) * _width + edit.x];
+    if (tile == edit.tile) continue;
+
+    tile = edit.tile;
+    _dirty[(edit.y / CHUNK_SIZE) * _chunks_x + edit.x / CHUNK_SIZE] = 1;
+  }
+
+  _applying.clear();
+}
+
+void Tilemap::MarkAllDirty() {
+  std::fill(_dirty.begin(), _dirty.end(), 1);
+}
+
+uint32_t Tilemap::Width() const {
+  return _width;
+}
+
+uint32_t Tilemap::Height() const {
+  return _height;
+}
+
+float Tilemap::TileSize() const {
+  return _tile_size;
+}
+
+uint32_t Tilemap::ChunkCount() const {
+  return _chunks_x * _chunks_y;
+}
+
+bool Tilemap::ChunkDirty(uint32_t chunk) const {
+  return _dirty[chunk] != 0;
+}
+
+void Tilemap::ClearDirty(uint32_t chunk) {
+  _dirty[chunk] = 0;
+}
+
+void Tilemap::VisibleChunks(glm::vec2 min, glm::vec2 max, std::vector<uint32_t>& out) const {
+  float chunkSize = _tile_size * CHUNK_SIZE;
+
+  int64_t firstX = std::max<int64_t>(static_cast<int64_t>(std::floor(min.x / chunkSize)), 0);
+  int64_t firstY = std::max<int64_t>(static_cast<int64_t>(std::floor(min.y / chunkSize)), 0);
+  int64_t lastX = std::min<int64_t>(static_cast<int64_t>(std::floor(max.x / chunkSize)), static_cast<int64_t>(_chunks_x) - 1);
+  int64_t lastY = std::min<int64_t>(static_cast<int64_t>(std::floor(max.y / chunkSize)), static_cast<int64_t>(_chunks_y) - 1);
+
+  for (int64_t y = firstY; y <= lastY; ++y) {
+    for (int64_t x = firstX; x <= lastX; ++x) {
+      out.push_back(static_cast<uint32_t>(y * _chunks_x + x));
+    }
+  }
+}
+
+glm::vec2 Tilemap::ChunkOrigin(uint32_t chunk) const {
+  return {(chunk % _chunks_x) * CHUNK_SIZE * _tile_size, (chunk / _chunks_x) * CHUNK_SIZE * _tile_size};
+}
+
+void Tilemap::BuildChunkGeometry(uint32_t chunk, std::vector<Vertex>& vertices) const {
+  vertices.clear();
+
+  uint32_t firstX = (chunk % _chunks_x) * CHUNK_SIZE;
+  uint32_t firstY = (chunk / _chunks_x) * CHUNK_SIZE;
+  uint32_t lastX = std::min(firstX + CHUNK_SIZE, _width);
+  uint32_t lastY = std::min(firstY + CHUNK_SIZE, _height);
+
+  const glm::vec3 white = {1.0f, 1.0f, 1.0f};
+
+  for (uint32_t y = firstY; y < lastY; ++y) {
+    for (uint32_t x = firstX; x < lastX; ++x) {
+      uint16_t tile = _tiles[static_cast<size_t>(y) * _width + x];
+      if (tile == 0 || tile > _tile_uvs.size()) continue;
+
+      const glm::vec4& uv = _tile_uvs[tile - 1];
+      float left = x * _tile_size, bottom = y * _tile_size;
+      float right = left + _tile_size, top = bottom + _tile_size;
+
+      vertices.push_back({{left, bottom}, white, {uv.x, uv.y}});
+      vertices.push_back({{right, bottom}, white, {uv.x + uv.z, uv.y}});
+      vertices.push_back({{right, top}, white, {uv.x + uv.z, uv.y + uv.w}});
+      vertices.push_back({{left, top}, white, {uv.x, uv.y + uv.w}});
+    }
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef TILEMAP_HPP
+#define TILEMAP_HPP
+
+#include "Vertex.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct TileEdit {
+  uint32_t x;
+  uint32_t y;
+  uint16_t tile;
+};
+
+// A grid of tiles split into CHUNK_SIZE x CHUNK_SIZE chunks. The renderer keeps each chunk's
+// geometry in its own static buffers and only rebuilds chunks whose tiles changed. Tile 0 is empty,
+// tile n uses tile_uvs[n - 1]. Tile (x, y) covers [x, x + 1) * tile_size in world units.
+//
+// SetTile can be called from any thread, edits are queued and only applied by the renderer between
+// frames, so chunk contents never change while a chunk is being built.
+class Tilemap {
+public:
+  // 32x32 quads is 4096 vertices, which keeps a chunk within a single draw of 16 bit indices
+  static const uint32_t CHUNK_SIZE = 32;
+
+  Tilemap(uint32_t width, uint32_t height, float tile_size, std::vector<glm::vec4> tile_uvs);
+  void SetTile(uint32_t x, uint32_t y, uint16_t tile);
+
+  // Everything below is for the renderer
+  void ApplyEdits();
+  void MarkAllDirty();
+  uint32_t Width() const;
+  uint32_t Height() const;
+  float TileSize() const;
+  uint32_t ChunkCount() const;
+  bool ChunkDirty(uint32_t chunk) const;
+  void ClearDirty(uint32_t chunk);
+  // Appends the chunks overlapping the world rect [min, max] to out
+  void VisibleChunks(glm::vec2 min, glm::vec2 max, std::vector<uint32_t>& out) const;
+  // World position of the chunk's bottom left corner
+  glm::vec2 ChunkOrigin(uint32_t chunk) const;
+  // Four vertices for every non-empty tile in the chunk, in the corner order of the renderer's shared quad indices
+  void BuildChunkGeometry(uint32_t chunk, std::vector<Vertex>& vertices) const;
+
+protected:
+  uint32_t _width;
+  uint32_t _height;
+  uint32_t _chunks_x;
+  uint32_t _chunks_y;
+  float _tile_size;
+  std::vector<glm::vec4> _tile_uvs;
+  std::vector<uint16_t> _tiles; // row major
+  std::vector<uint8_t> _dirty;  // per chunk
+
+  std::mutex _edits_mutex;
+  std::vector<TileEdit> _edits;
+  std::vector<TileEdit> _applying; // swapped with _edits so the lock is only held for the swap
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// Single producer, single consumer handoff of the latest value. The producer always has a buffer to
+// write and the consumer always has one to read, the third is swapped between them with one atomic
+// exchange, so neither side ever waits on the other. Values the consumer didn't get to are dropped.
+template <typename T>
+class TripleBuffer {
+public:
+  // Producer side, fill this in and then Publish()
+  T& WriteBuffer() { return _buffers[_write]; }
+
+  void Publish() {
+    uint8_t previous = _shared.exchange(_write | DIRTY, std::memory_order_acq_rel);
+    _write = previous & INDEX_MASK;
+  }
+
+  // Consumer side, swaps in the newest published value. Returns false if nothing was published
+  // since the last call, ReadBuffer() then still holds the previous value.
+  bool Acquire() {
+    if ((_shared.load(std::memory_order_relaxed) & DIRTY) == 0)
+      return false;
+
+    uint8_t previous = _shared.exchange(_read, std::memory_order_acq_rel);
+    _read = previous & INDEX_MASK;
+    return true;
+  }
+
+  const T& ReadBuffer() const { return _buffers[_read]; }
+
+protected:
+  static const uint8_t INDEX_MASK = 0x3;
+  static const uint8_t DIRTY = 0x4;
+
+  T _buffers[3];
+  uint8_t _write = 0;
+  uint8_t _read = 1;
+  std::atomic<uint8_t> _shared{2};
+};
+
+#endif
@@ -9,8 +9,8 @@ VkVertexInputBindingDescription Vertex::GetBindingDescription() {
   return bindingDescription;
 }
 
-std::array<VkVertexInputAttributeDescription, 3> Vertex::GetAttributeDescriptions() {
-  std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
+std::array<VkVertexInputAttributeDescription, 4> Vertex::GetAttributeDescriptions() {
+  std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions = {};
 
   attributeDescriptions[0].binding = 0;
   attributeDescriptions[0].location = 0;
@@ -27,5 +27,45 @@ std::array<VkVertexInputAttributeDescription, 3> Vertex::GetAttributeDescription
   attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
   attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
 
+  attributeDescriptions[3].binding = 0;
+  attributeDescriptions[3].location = 3;
+  attributeDescriptions[3].format = VK_FORMAT_R32_UINT;
+  attributeDescriptions[3].offset = offsetof(Vertex, texture);
+
+  return attributeDescriptions;
+}
+
+VkVertexInputBindingDescription PackedVertex::GetBindingDescription() {
+  VkVertexInputBindingDescription bindingDescription = {};
+  bindingDescription.binding = 0;
+  bindingDescription.stride = sizeof(PackedVertex);
+  bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+  return bindingDescription;
+}
+
+std::array<VkVertexInputAttributeDescription, 4> PackedVertex::GetAttributeDescriptions() {
+  std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions = {};
+
+  attributeDescriptions[0].binding = 0;
+  attributeDescriptions[0].location = 0;
+  attributeDescriptions[0].format = VK_FORMAT_R16G16_SNORM;
+  attributeDescriptions[0].offset = offsetof(PackedVertex, pos);
+
+  attributeDescriptions[1].binding = 0;
+  attributeDescriptions[1].location = 1;
+  attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+  attributeDescriptions[1].offset = offsetof(PackedVertex, color);
+
+  attributeDescriptions[2].binding = 0;
+  attributeDescriptions[2].location = 2;
+  attributeDescriptions[2].format = VK_FORMAT_R16G16_UNORM;
+  attributeDescriptions[2].offset = offsetof(PackedVertex, texCoord);
+
+  attributeDescriptions[3].binding = 0;
+  attributeDescriptions[3].location = 3;
+  attributeDescriptions[3].format = VK_FORMAT_R16_UINT;
+  attributeDescriptions[3].offset = offsetof(PackedVertex, texture);
+
   return attributeDescriptions;
 }
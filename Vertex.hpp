@@ -1,12 +1,62 @@
+#ifndef VERTEX_HPP
+#define VERTEX_HPP
+
 #include "VulkanHeaders.hpp"
 
 #include <array>
+#include <cstdint>
+
+// Layout sprites and tiles are streamed in, the background quad always uses Vertex
+enum class VertexFormat {
+  Full,  // Vertex, 32 bytes
+  Packed // PackedVertex, 16 bytes
+};
 
 struct Vertex {
   glm::vec2 pos;
   glm::vec3 color;
   glm::vec2 texCoord;
+  uint32_t texture = 0; // only read with bindless textures, otherwise draws are split per texture
 
   static VkVertexInputBindingDescription GetBindingDescription();
-  static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescriptions();
+  static std::array<VkVertexInputAttributeDescription, 4> GetAttributeDescriptions();
 };
+
+// Vertex quantized for bandwidth. Positions are snorm offsets from an origin pushed per draw, scaled by
+// POSITION_RANGE, so they step in 1/8 units and clamp beyond 4096 units from the origin. Colors are 8 bit
+// and UVs 16 bit unorm, which is all the atlas needs.
+struct PackedVertex {
+  static constexpr float POSITION_RANGE = 4096.0f; // must match shaders/sprite.vert
+
+  int16_t pos[2];
+  uint8_t color[4];
+  uint16_t texCoord[2];
+  uint16_t texture;
+  uint16_t padding;
+
+  static PackedVertex Pack(glm::vec2 pos, glm::vec2 origin, glm::vec3 color, glm::vec2 texCoord, uint32_t texture = 0);
+  static VkVertexInputBindingDescription GetBindingDescription();
+  static std::array<VkVertexInputAttributeDescription, 4> GetAttributeDescriptions();
+};
+
+// Inline since it runs for every sprite vertex every frame
+inline PackedVertex PackedVertex::Pack(glm::vec2 pos, glm::vec2 origin, glm::vec3 color, glm::vec2 texCoord, uint32_t texture) {
+  glm::vec2 p = glm::round(glm::clamp((pos - origin) / POSITION_RANGE, -1.0f, 1.0f) * 32767.0f);
+  glm::vec3 c = glm::round(glm::clamp(color, 0.0f, 1.0f) * 255.0f);
+  glm::vec2 t = glm::round(glm::clamp(texCoord, 0.0f, 1.0f) * 65535.0f);
+
+  PackedVertex v;
+  v.pos[0] = static_cast<int16_t>(p.x);
+  v.pos[1] = static_cast<int16_t>(p.y);
+  v.color[0] = static_cast<uint8_t>(c.r);
+  v.color[1] = static_cast<uint8_t>(c.g);
+  v.color[2] = static_cast<uint8_t>(c.b);
+  v.color[3] = 255;
+  v.texCoord[0] = static_cast<uint16_t>(t.x);
+  v.texCoord[1] = static_cast<uint16_t>(t.y);
+  v.texture = static_cast<uint16_t>(texture);
+  v.padding = 0;
+  return v;
+}
+
+#endif
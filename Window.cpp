@@ -4,11 +4,15 @@
 #include <chrono>
 
 Window::~Window() {
+  game_ending = true;
+  if (_render_thread.joinable())
+    _render_thread.join();
+
   glfwDestroyWindow(_window);
   glfwTerminate();
 }
 
-bool Window::Init(unsigned window_width, unsigned window_height, const char* window_caption) {
+bool Window::Init(unsigned window_width, unsigned window_height, const char* window_caption, double frame_limit) {
   glfwInit();
 
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -23,41 +27,122 @@ bool Window::Init(unsigned window_width, unsigned window_height, const char* win
 
   glfwSetWindowUserPointer(_window, this);
 
+  if (frame_limit <= 0) {
+    const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    frame_limit = (mode != nullptr) ? mode->refreshRate : 60;
+  }
+  _pacer.SetTargetFps(frame_limit);
+
+  // The camera stays well within PackedVertex range of everything in a snapshot
+  _renderer.SetVertexFormat(VertexFormat::Packed);
   if (!_renderer.Init(_window, window_caption, window_caption, GetExtensions())) {
     std::cerr << "Failed to initialize renderer" << std::endl;
     return false;
   }
 
-  auto updateSwapChain = [](GLFWwindow* w, int, int) {
-    static_cast<Window*>(glfwGetWindowUserPointer(w))->_renderer.framebuffer_resized = true;
+  auto updateSwapChain = [](GLFWwindow* w, int width, int height) {
+    static_cast<Window*>(glfwGetWindowUserPointer(w))->_renderer.NotifyFramebufferResized(width, height);
   };
   
   glfwSetFramebufferSizeCallback(_window, updateSwapChain);
+
+  auto keyPressed = [](GLFWwindow* w, int key, int, int action, int) {
+    if (action != GLFW_PRESS) return;
+    Window* window = static_cast<Window*>(glfwGetWindowUserPointer(w));
+
+    // Cycles low latency -> vsync -> throughput
+    if (key == GLFW_KEY_F1) window->_cycle_latency_mode = true;
+    if (key == GLFW_KEY_F3) window->_print_histogram = true;
+    // First press starts a capture, the second one writes it out
+    if (key == GLFW_KEY_F12) window->_toggle_capture = true;
+  };
+
+  glfwSetKeyCallback(_window, keyPressed);
+
+  _render_thread = std::thread(&Window::RenderLoop, this);
   
   return true;
 }
 
-static double previousTime = 0;
-static int frameCount = 0;
-
-void Window::Poll() {
-  while (!glfwWindowShouldClose(_window) && !game_ending) {
-    glfwPollEvents();
-    _renderer.DrawFrame();
-
-    // Measure speed
-    double currentTime = glfwGetTime();
-    frameCount++;
-    // If a second has passed.
-    if ( currentTime - previousTime >= 1.0 )
-    {
-        // Display the frame count here any way you want.
-        std::cout << "fps: " << frameCount << std::endl;
-
-        frameCount = 0;
-        previousTime = currentTime;
+void Window::PollEvents() {
+  PROFILE_SCOPE("PollEvents");
+  glfwPollEvents();
+
+  if (glfwWindowShouldClose(_window))
+    game_ending = true;
+}
+
+FrameSnapshot& Window::BeginSnapshot() {
+  return _snapshots.WriteBuffer();
+}
+
+void Window::PublishSnapshot() {
+  _snapshots.Publish();
+}
+
+void Window::HandleRequests() {
+  if (_cycle_latency_mode.exchange(false)) {
+    LatencyMode mode = static_cast<LatencyMode>((static_cast<int>(_renderer.GetLatencyMode()) + 1) % 3);
+    if (_renderer.SetLatencyMode(mode)) {
+      _pacer.Reset();
+      _renderer.GetFrameStats().Reset();
+      std::cout << "Latency mode: " << Renderer::LatencyModeName(mode) << std::endl;
+    }
+  }
+
+  if (_print_histogram.exchange(false)) {
+    _renderer.GetFrameStats().PrintHistogram(std::cout);
+  }
+
+  // Toggled between frames so the render thread isn't in the middle of a span while the trace is written
+  if (_toggle_capture.exchange(false)) {
+    if (!Profiler::Enabled()) {
+      Profiler::Clear();
+      Profiler::SetEnabled(true);
+      std::cout << "Profiler capture started" << std::endl;
+    } else {
+      Profiler::SetEnabled(false);
+      Profiler::WriteChromeTrace("trace.json");
+    }
+  }
+}
+
+void Window::RenderLoop() {
+  auto previousFrame = std::chrono::steady_clock::now();
+  auto previousReport = previousFrame;
+  FrameStats& stats = _renderer.GetFrameStats();
+
+  while (!game_ending) {
+    HandleRequests();
+
+    // Without a new snapshot the last one is drawn again, the game running slow shouldn't stall presenting
+    _snapshots.Acquire();
+    _renderer.DrawFrame(_snapshots.ReadBuffer());
+
+    // FIFO already blocks in present, pacing on top of it would only fight the vblank
+    if (_renderer.GetLatencyMode() != LatencyMode::VSync) {
+      PROFILE_SCOPE("FramePacer");
+      _pacer.Wait();
+    }
+
+    auto currentFrame = std::chrono::steady_clock::now();
+    stats.Record(FrameMetric::CpuFrame, std::chrono::duration<double, std::milli>(currentFrame - previousFrame).count());
+    previousFrame = currentFrame;
+
+    // Percentiles over the last few hundred frames, an fps counter would hide the hitches
+    if (currentFrame - previousReport >= std::chrono::seconds(1)) {
+      stats.PrintSummary(std::cout);
+      const FrameSnapshot& snapshot = _snapshots.ReadBuffer();
+      std::cout << "sprites: submitted " << snapshot.sprites.size() << ", culled " << snapshot.culled_sprites << std::endl;
+      if (_renderer.GetLatencyMode() != LatencyMode::VSync) {
+        std::cout << "pacer: target " << _pacer.TargetFps() << " fps, smoothed " << _pacer.SmoothedFrameMs() 
+          << " ms, missed " << _pacer.MissedDeadlines() << std::endl;
+      }
+      previousReport = currentFrame;
     }
-  } game_ending = true;
+  }
+
+  stats.PrintHistogram(std::cout);
 }
 
 std::vector<const char*> Window::GetExtensions() {
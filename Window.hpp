@@ -1,24 +1,45 @@
 #ifndef WINDOW_HPP
 #define WINDOW_HPP
 
+#include "FramePacer.hpp"
 #include "Renderer.hpp"
+#include "TripleBuffer.hpp"
 
+#include <atomic>
+#include <thread>
 #include <vector>
 
+// Owns the window and the render thread. Events are pumped on the main thread (GLFW requires it), frames
+// are drawn on the render thread from the latest snapshot the game published.
 class Window {
 public:
   Window() = default;
   ~Window();
-  bool Init(unsigned window_width, unsigned window_height, const char* window_caption);
-  void Poll();
+  // A frame limit of 0 paces to the monitor's refresh rate
+  bool Init(unsigned window_width, unsigned window_height, const char* window_caption, double frame_limit = 0);
+  // Main thread only
+  void PollEvents();
+  // Game side of the handoff, fill in the snapshot then publish it. The buffer is reused, so it still
+  // holds whatever was written into it two publishes ago.
+  FrameSnapshot& BeginSnapshot();
+  void PublishSnapshot();
 
-  bool game_ending = false;
+  std::atomic<bool> game_ending{false};
 
 protected:
   std::vector<const char*> GetExtensions();
+  void RenderLoop();
+  void HandleRequests();
 
-  GLFWwindow* _window;
+  GLFWwindow* _window = nullptr;
   Renderer _renderer;
+  FramePacer _pacer;
+  TripleBuffer<FrameSnapshot> _snapshots;
+  std::thread _render_thread;
+  // Keys arrive on the main thread but act on render state, so the render thread picks them up
+  std::atomic<bool> _cycle_latency_mode{false};
+  std::atomic<bool> _print_histogram{false};
+  std::atomic<bool> _toggle_capture{false};
 };
 
 #endif
@@ -0,0 +1,83 @@
+#include "WorkerPool.hpp"
+
+WorkerPool::WorkerPool(unsigned thread_count) {
+  for (unsigned i = 0; i < thread_count; ++i)
+    _threads.emplace_back(&WorkerPool::WorkerLoop, this);
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _wake.notify_all();
+
+  for (auto& t : _threads) t.join();
+}
+
+unsigned WorkerPool::Concurrency() const {
+  return static_cast<unsigned>(_threads.size()) + 1;
+}
+
+void WorkerPool::Dispatch(unsigned job_count, const std::function<void(unsigned)>& job) {
+  if (job_count == 0) return;
+
+  // Not worth waking anyone up for
+  if (job_count == 1 || _threads.empty()) {
+    for (unsigned i = 0; i < job_count; ++i) job(i);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _job = &job;
+    _job_count = job_count;
+    _jobs_done = 0;
+    _next_job = 0;
+    ++_generation;
+  }
+  _wake.notify_all();
+
+  unsigned finished = RunJobs(&job, job_count);
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  _jobs_done += finished;
+  // Workers still inside RunJobs hold a pointer to job, so wait for them to leave too
+  _done.wait(lock, [this]() { return _jobs_done == _job_count && _active == 0; });
+  _job = nullptr;
+}
+
+unsigned WorkerPool::RunJobs(const std::function<void(unsigned)>* job, unsigned job_count) {
+  unsigned finished = 0;
+  for (unsigned i = _next_job.fetch_add(1); i < job_count; i = _next_job.fetch_add(1)) {
+    (*job)(i);
+    ++finished;
+  }
+
+  return finished;
+}
+
+void WorkerPool::WorkerLoop() {
+  uint64_t seen = 0;
+  while (true) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _wake.wait(lock, [this, &seen]() { return _stopping || _generation != seen; });
+    if (_stopping) return;
+
+    seen = _generation;
+    const std::function<void(unsigned)>* job = _job;
+    unsigned job_count = _job_count;
+    // The dispatch may already be over by the time we wake up
+    if (job == nullptr) continue;
+
+    ++_active;
+    lock.unlock();
+
+    unsigned finished = RunJobs(job, job_count);
+
+    lock.lock();
+    _jobs_done += finished;
+    --_active;
+    if (_jobs_done == _job_count && _active == 0) _done.notify_all();
+  }
+}
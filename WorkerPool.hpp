@@ -0,0 +1,43 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads for fork/join style jobs. The calling thread takes part in every dispatch
+// so a pool with zero threads still works, just serially.
+class WorkerPool {
+public:
+  explicit WorkerPool(unsigned thread_count);
+  ~WorkerPool();
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // Number of jobs that can run at the same time (workers plus the caller)
+  unsigned Concurrency() const;
+  // Runs job(0) .. job(job_count - 1) and blocks until all of them have returned
+  void Dispatch(unsigned job_count, const std::function<void(unsigned)>& job);
+
+protected:
+  void WorkerLoop();
+  unsigned RunJobs(const std::function<void(unsigned)>* job, unsigned job_count);
+
+  std::vector<std::thread> _threads;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  const std::function<void(unsigned)>* _job = nullptr;
+  unsigned _job_count = 0;
+  unsigned _jobs_done = 0;
+  unsigned _active = 0;
+  uint64_t _generation = 0;
+  bool _stopping = false;
+  std::atomic<unsigned> _next_job{0};
+};
+
+#endif
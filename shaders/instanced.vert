@@ -0,0 +1,27 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inSize;
+layout(location = 2) in vec4 inTexRect;
+layout(location = 3) in vec4 inColor;
+layout(location = 4) in uint inTexture;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTexture;
+
+void main() {
+    // Drawn with the background quad's indices, corners follow the order of its four vertices
+    vec2 corner = vec2(gl_VertexIndex == 1 || gl_VertexIndex == 2, gl_VertexIndex >= 2);
+    vec2 position = inPosition + corner * inSize;
+    gl_Position = ubo.proj * ubo.view * vec4(position.x, position.y, 0.0, 1.0);
+    fragColor = inColor.rgb;
+    fragTexCoord = inTexRect.xy + corner * inTexRect.zw;
+    fragTexture = inTexture;
+}
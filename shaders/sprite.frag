@@ -0,0 +1,32 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Every registered texture, sized by the renderer and only partially bound
+layout(binding = 1) uniform sampler2D textures[];
+#else
+// Whichever texture's descriptor set is bound
+layout(binding = 1) uniform sampler2D texSampler;
+#endif
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragTexture;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+#ifdef BINDLESS
+    // Neighbouring quads in one draw can use different textures
+    outColor = texture(textures[nonuniformEXT(fragTexture)], fragTexCoord);
+#else
+    outColor = texture(texSampler, fragTexCoord);
+#endif
+#ifdef ALPHA_TEST
+    // Opaque sprites write depth, their transparent texels mustn't hide what's behind them
+    if (outColor.a < 0.5)
+        discard;
+#endif
+}
@@ -0,0 +1,43 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// PACKED reads PackedVertex, relative to a pushed origin, otherwise Vertex in world units
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+#ifdef PACKED
+// PackedVertex::POSITION_RANGE
+const float POSITION_RANGE = 4096.0;
+
+// World position the packed offsets are relative to, the camera for sprites and the chunk corner for tiles
+layout(push_constant) uniform Origin {
+    vec2 origin;
+} pc;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec4 inColor;
+#else
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+#endif
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in uint inTexture;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTexture;
+
+void main() {
+#ifdef PACKED
+    vec2 position = pc.origin + inPosition * POSITION_RANGE;
+#else
+    vec2 position = inPosition;
+#endif
+    gl_Position = ubo.proj * ubo.view * vec4(position.x, position.y, 0.0, 1.0);
+    fragColor = inColor.rgb;
+    fragTexCoord = inTexCoord;
+    fragTexture = inTexture;
+}